@@ -0,0 +1,176 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: arena.c
+ *
+ *       Implementation of the bump-pointer arena.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "memcheck.h"
+
+/* Chunk data starts after the header, rounded up to ARENA_ALIGN. */
+#define CHUNK_HEADER \
+    ((sizeof(arena_chunk) + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1))
+
+static void new_chunk(arena *a, size_t size);
+static size_t size_class(size_t size, size_t *rounded);
+
+
+void arena_init(arena *a)
+{
+    a->pos = NULL;
+    a->end = NULL;
+    a->chunks = NULL;
+    a->size = 0;
+    a->free_blocks = NULL;
+}
+
+
+/* Start a new chunk with room for at least 'size' bytes. */
+static void new_chunk(arena *a, size_t size)
+{
+    arena_chunk *c;
+    if (size < ARENA_CHUNK_SIZE - CHUNK_HEADER)
+    {
+        size = ARENA_CHUNK_SIZE - CHUNK_HEADER;
+    }
+    c = (arena_chunk *) malloc(CHUNK_HEADER + size);
+    if (c == NULL)
+    {
+        printf("Failed to allocate memory; exiting\n");
+        exit(1);
+    }
+    c->next = a->chunks;
+    a->chunks = c;
+    a->pos = (char *) c + CHUNK_HEADER;
+    a->end = a->pos + size;
+}
+
+
+void *arena_alloc(arena *a, size_t size)
+{
+    char *p;
+    size_t pad;
+    pad = (ARENA_ALIGN - (size_t) a->pos % ARENA_ALIGN) % ARENA_ALIGN;
+    if (a->pos == NULL || (size_t) (a->end - a->pos) < pad + size)
+    {
+        new_chunk(a, size);
+        pad = 0;
+    }
+    p = a->pos + pad;
+    a->pos = p + size;
+    a->size += size;
+    return p;
+}
+
+
+char *arena_strdup(arena *a, char *s, size_t len)
+{
+    char *p;
+    /* strings need no alignment, so they pack tightly */
+    if (a->pos == NULL || (size_t) (a->end - a->pos) < len + 1)
+    {
+        new_chunk(a, len + 1);
+    }
+    p = a->pos;
+    memcpy(p, s, len);
+    p[len] = '\0';
+    a->pos += len + 1;
+    a->size += len + 1;
+    return p;
+}
+
+
+/* The class of a reusable block of 'size' bytes, and its real size. */
+static size_t size_class(size_t size, size_t *rounded)
+{
+    size_t c;
+    if (size <= ARENA_SMALL_MAX)
+    {
+        c = size == 0 ? 0 : (size - 1) / ARENA_ALIGN;
+        *rounded = (c + 1) * ARENA_ALIGN;
+        return c;
+    }
+    c = ARENA_SMALL_CLASSES;
+    *rounded = 2 * ARENA_SMALL_MAX;
+    while (*rounded < size)
+    {
+        *rounded *= 2;
+        c++;
+    }
+    return c;
+}
+
+
+void *arena_alloc_reusable(arena *a, size_t size)
+{
+    size_t c, rounded;
+    void *p;
+    c = size_class(size, &rounded);
+    if (a->free_blocks == NULL || a->free_blocks[c] == NULL)
+    {
+        return arena_alloc(a, rounded);
+    }
+    /* a block on a list holds the next one in its first bytes */
+    p = a->free_blocks[c];
+    a->free_blocks[c] = *(void **) p;
+    a->size += rounded;
+    return p;
+}
+
+
+char *arena_strdup_reusable(arena *a, char *s, size_t len)
+{
+    char *p;
+    p = (char *) arena_alloc_reusable(a, len + 1);
+    memcpy(p, s, len);
+    p[len] = '\0';
+    return p;
+}
+
+
+void arena_start_reuse(arena *a)
+{
+    if (a->free_blocks != NULL)
+    {
+        return;
+    }
+    a->free_blocks = (void **) calloc(ARENA_CLASSES, sizeof(void *));
+    if (a->free_blocks == NULL)
+    {
+        printf("Failed to allocate memory; exiting\n");
+        exit(1);
+    }
+}
+
+
+void arena_release(arena *a, void *p, size_t size)
+{
+    size_t c, rounded;
+    c = size_class(size, &rounded);
+    arena_start_reuse(a);
+    *(void **) p = a->free_blocks[c];
+    a->free_blocks[c] = p;
+    a->size -= rounded;
+}
+
+
+void arena_free(arena *a)
+{
+    arena_chunk *c, *next;
+    for (c = a->chunks; c != NULL; c = next)
+    {
+        next = c->next;
+        free(c);
+    }
+    if (a->free_blocks != NULL)
+    {
+        free(a->free_blocks);
+    }
+    arena_init(a);
+}
@@ -0,0 +1,83 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: arena.h
+ *
+ *       A bump-pointer arena: many small allocations carved out of a
+ *       few large chunks, all released together.  Blocks allocated as
+ *       reusable can also be handed back one at a time, to be given
+ *       out again by the next reusable allocation of their size.
+ *
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/* Bytes in each chunk (bigger requests get a chunk of their own). */
+#define ARENA_CHUNK_SIZE (64 * 1024)
+
+/* Alignment of the blocks returned by arena_alloc. */
+#define ARENA_ALIGN 8
+
+/*
+ * Reusable blocks are rounded up to a size class: multiples of
+ * ARENA_ALIGN up to ARENA_SMALL_MAX bytes, then powers of two.  Each
+ * class has a list of the blocks handed back.
+ */
+#define ARENA_SMALL_MAX     256
+#define ARENA_SMALL_CLASSES (ARENA_SMALL_MAX / ARENA_ALIGN)
+#define ARENA_CLASSES       (ARENA_SMALL_CLASSES + 8 * sizeof(size_t))
+
+typedef struct _arena_chunk
+{
+    struct _arena_chunk *next;  /* the previously filled chunk */
+} arena_chunk;
+
+typedef struct
+{
+    char *pos;              /* next free byte of the current chunk */
+    char *end;              /* end of the current chunk            */
+    arena_chunk *chunks;    /* all the chunks, newest first        */
+    size_t size;            /* bytes handed out (and not back)     */
+    void **free_blocks;     /* ARENA_CLASSES lists of blocks handed
+                               back, or NULL until the first one    */
+} arena;
+
+/* Set up an empty arena; no memory is allocated until it's used. */
+void arena_init(arena *a);
+
+/* Allocate 'size' bytes aligned to ARENA_ALIGN. */
+void *arena_alloc(arena *a, size_t size);
+
+/* Copy the 'len' bytes of 's' and a terminating zero byte. */
+char *arena_strdup(arena *a, char *s, size_t len);
+
+/*
+ * Allocate 'size' bytes aligned to ARENA_ALIGN, which can be handed
+ * back with arena_release, and the same for a copy of a string.
+ */
+void *arena_alloc_reusable(arena *a, size_t size);
+char *arena_strdup_reusable(arena *a, char *s, size_t len);
+
+/*
+ * Hand back a block from arena_alloc_reusable of 'size' bytes (or from
+ * arena_strdup_reusable of a string of 'size' - 1 bytes).
+ */
+void arena_release(arena *a, void *p, size_t size);
+
+/*
+ * Set up the lists of blocks handed back, if they aren't yet (the
+ * first arena_release does it too).  A user that only needs reusable
+ * blocks once it starts handing them back can pack its strings with
+ * arena_strdup until ARENA_REUSING says it has called this.
+ */
+void arena_start_reuse(arena *a);
+
+#define ARENA_REUSING(a) ((a)->free_blocks != NULL)
+
+/* Release every chunk at once. */
+void arena_free(arena *a);
+
+#endif  /* ARENA_H */
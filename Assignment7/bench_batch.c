@@ -0,0 +1,149 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: bench_batch.c
+ *
+ *       Benchmark of batched lookups.  A table of many generated keys
+ *       (by default enough to be several times the size of a large
+ *       L3 cache) is looked up in random order, once a key at a time
+ *       with get_value and once with get_values_batch, and the
+ *       lookups per second of both are reported.  In a table this big
+ *       nearly every lookup misses the cache, so this measures how
+ *       well the batches overlap their misses.
+ *
+ *       usage: bench_batch [nkeys]
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "hash_table.h"
+
+#define DEFAULT_KEYS 4000000
+#define NQUERIES     4000000
+#define KEY_LENGTH   24     /* room for "key" and a number */
+#define CHUNK        1024   /* keys per call of get_values_batch */
+
+
+void usage(char *progname)
+{
+    fprintf(stderr, "usage: %s [nkeys]\n", progname);
+}
+
+
+void out_of_memory(void)
+{
+    fprintf(stderr, "Error: memory allocation failed! "
+                    "Terminating program.\n");
+    exit(1);
+}
+
+
+double seconds_since(clock_t start)
+{
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+
+/* A simple generator, so every run asks for the same keys. */
+unsigned long next_random(unsigned long *state)
+{
+    *state = *state * 6364136223846793005UL + 1442695040888963407UL;
+    return *state >> 17;
+}
+
+
+int main(int argc, char **argv)
+{
+    hash_table *ht;
+    char key[KEY_LENGTH];
+    char *text, **queries;
+    int values[CHUNK];
+    long nkeys, i, q, len, pos, one_total, batch_total;
+    unsigned long state;
+    clock_t start;
+    double fill_secs, one_secs, batch_secs;
+
+    nkeys = DEFAULT_KEYS;
+    if (argc > 2 || (argc == 2 && (nkeys = atol(argv[1])) <= 0))
+    {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    /* Fill the table: "key0" has the value 1, "key1" 2 and so on. */
+    ht = create_hash_table();
+    start = clock();
+
+    for (i = 0; i < nkeys; i++)
+    {
+        len = sprintf(key, "key%ld", i);
+        *find_or_insert_n(ht, key, len) = (int) (i + 1);
+    }
+
+    fill_secs = seconds_since(start);
+
+    /*
+     * The queries are random keys, written one after another so that
+     * reading them is cheap next to looking them up.
+     */
+    text = (char *) malloc(NQUERIES * KEY_LENGTH);
+    queries = (char **) malloc(NQUERIES * sizeof(char *));
+    if (text == NULL || queries == NULL) out_of_memory();
+    state = 1;
+    pos = 0;
+
+    for (q = 0; q < NQUERIES; q++)
+    {
+        queries[q] = text + pos;
+        pos += sprintf(text + pos, "key%lu", next_random(&state) % nkeys)
+               + 1;
+    }
+
+    /* One at a time. */
+    one_total = 0;
+    start = clock();
+
+    for (q = 0; q < NQUERIES; q++)
+    {
+        one_total += get_value(ht, queries[q]);
+    }
+
+    one_secs = seconds_since(start);
+
+    /* In batches. */
+    batch_total = 0;
+    start = clock();
+
+    for (q = 0; q < NQUERIES; q += CHUNK)
+    {
+        len = NQUERIES - q < CHUNK ? NQUERIES - q : CHUNK;
+        get_values_batch(ht, queries + q, (int) len, values);
+        for (i = 0; i < len; i++)
+        {
+            batch_total += values[i];
+        }
+    }
+
+    batch_secs = seconds_since(start);
+
+    printf("%s: %ld keys (filled in %.2f s), %d random lookups\n",
+           argv[0], nkeys, fill_secs, NQUERIES);
+    printf("  get_value        %8.3f s %10.2f M lookups/s\n",
+           one_secs, NQUERIES / one_secs / 1e6);
+    printf("  get_values_batch %8.3f s %10.2f M lookups/s (%.2fx)\n",
+           batch_secs, NQUERIES / batch_secs / 1e6, one_secs / batch_secs);
+
+    if (one_total != batch_total)
+    {
+        printf("  The results differ! (%ld and %ld)\n",
+               one_total, batch_total);
+    }
+
+    free(queries);
+    free(text);
+    free_hash_table(ht);
+    return 0;
+}
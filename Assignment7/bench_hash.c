@@ -0,0 +1,341 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: bench_hash.c
+ *
+ *       Benchmark of the hash table on the word-count workload of
+ *       main.c.  The words of the input file are counted into a
+ *       table, then every word is looked up again a few times, and
+ *       then as many words that aren't in the table (each word with a
+ *       '#' on the end).  Reports words inserted and looked up per
+ *       second and the distribution of chain lengths in the finished
+ *       table.
+ *
+ *       usage: bench_hash [-b] filename
+ *
+ *       With -b the table gets a Bloom filter, sized for a hundredth of
+ *       the words (so it is rebuilt a few times as the table grows),
+ *       and its false positive rate is reported too.
+ *
+ *       The Makefile builds this with the current hash, with the
+ *       original additive one (-DADDITIVE_HASH) and with the open
+ *       addressing table (-DOPEN_ADDRESSING), all without the memory
+ *       checker (-DNO_MEMCHECK).
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "hash_table.h"
+
+#define MAX_WORD_LENGTH 100
+#define MAX_CHAIN       8   /* Longer chains are counted together. */
+#define LOOKUP_PASSES   5
+
+
+void usage(char *progname)
+{
+    fprintf(stderr, "usage: %s [-b] filename\n", progname);
+}
+
+
+void out_of_memory(void)
+{
+    fprintf(stderr, "Error: memory allocation failed! "
+                    "Terminating program.\n");
+    exit(1);
+}
+
+
+/*
+ * Read the words of a file, one per line, into an array.  The number
+ * of words goes into '*nwords'.
+ */
+char **read_words(FILE *input_file, long *nwords)
+{
+    char  word[MAX_WORD_LENGTH];
+    char  line[MAX_WORD_LENGTH];
+    char **words;
+    long  n, size;
+
+    n = 0;
+    size = 1024;
+    words = (char **) malloc(size * sizeof(char *));
+    if (words == NULL) out_of_memory();
+
+    while (fgets(line, MAX_WORD_LENGTH, input_file) != NULL)
+    {
+        if (sscanf(line, "%s", word) != 1)
+        {
+            continue;
+        }
+
+        if (n == size)
+        {
+            size *= 2;
+            words = (char **) realloc(words, size * sizeof(char *));
+            if (words == NULL) out_of_memory();
+        }
+
+        words[n] = (char *) malloc(strlen(word) + 1);
+        if (words[n] == NULL) out_of_memory();
+        strcpy(words[n], word);
+        n++;
+    }
+
+    *nwords = n;
+    return words;
+}
+
+
+#ifndef OPEN_ADDRESSING
+
+/* Count the chain lengths of one slot array into 'hist'. */
+void chain_lengths(node **slot, unsigned long first, unsigned long last,
+                   unsigned long *hist, unsigned long *longest,
+                   double *probes)
+{
+    unsigned long i, len;
+    node *n;
+
+    for (i = first; i < last; i++)
+    {
+        len = 0;
+
+        for (n = slot[i]; n != NULL; n = n->next)
+        {
+            len++;
+        }
+
+        hist[len < MAX_CHAIN ? len : MAX_CHAIN]++;
+
+        if (len > *longest)
+        {
+            *longest = len;
+        }
+
+        /* Finding each key of the chain once takes 1 + 2 + ... + len. */
+        *probes += len * (len + 1) / 2.0;
+    }
+}
+
+
+/* The number of keys and slots of the table. */
+void table_size(hash_table *ht, unsigned long *nkeys, unsigned long *nslots)
+{
+    *nkeys = ht->count;
+    *nslots = ht->nslots;
+}
+
+
+void print_chain_lengths(hash_table *ht)
+{
+    unsigned long hist[MAX_CHAIN + 1];
+    unsigned long longest, nslots;
+    double probes;
+    int i;
+
+    memset(hist, 0, sizeof(hist));
+    longest = 0;
+    probes = 0.0;
+    nslots = ht->nslots;
+
+    chain_lengths(ht->slot, 0, ht->nslots, hist, &longest, &probes);
+
+    if (ht->old_slot != NULL)
+    {
+        chain_lengths(ht->old_slot, ht->migrated, ht->old_nslots,
+                      hist, &longest, &probes);
+        nslots += ht->old_nslots - ht->migrated;
+    }
+
+    printf("  chain length   slots   (%% of %lu)\n", nslots);
+
+    for (i = 0; i <= MAX_CHAIN; i++)
+    {
+        printf("  %5d%s %12lu   %6.2f\n", i, i == MAX_CHAIN ? "+" : " ",
+               hist[i], 100.0 * hist[i] / nslots);
+    }
+
+    printf("  longest chain %lu, %.2f keys compared per lookup\n",
+           longest, probes / ht->count);
+}
+
+#else  /* OPEN_ADDRESSING */
+
+void table_size(hash_table *ht, unsigned long *nkeys, unsigned long *nslots)
+{
+    *nkeys = ht->table.count;
+    *nslots = ht->table.nslots;
+}
+
+
+/* The distribution of the distances of entries from their home slot. */
+void print_chain_lengths(hash_table *ht)
+{
+    unsigned long hist[MAX_CHAIN + 1];
+    unsigned long i, dist, longest, mask;
+    double probes;
+    int j;
+
+    memset(hist, 0, sizeof(hist));
+    longest = 0;
+    probes = 0.0;
+    mask = ht->table.nslots - 1;
+
+    for (i = 0; i < ht->table.nslots; i++)
+    {
+        if (ht->table.entry[i].key == NULL)
+        {
+            continue;
+        }
+
+        dist = (i - ht->table.entry[i].hash) & mask;
+        hist[dist < MAX_CHAIN ? dist : MAX_CHAIN]++;
+
+        if (dist > longest)
+        {
+            longest = dist;
+        }
+
+        probes += dist + 1;
+    }
+
+    printf("  distance from home   keys   (%% of %lu)\n", ht->table.count);
+
+    for (j = 0; j <= MAX_CHAIN; j++)
+    {
+        printf("  %5d%s %12lu   %6.2f\n", j, j == MAX_CHAIN ? "+" : " ",
+               hist[j], 100.0 * hist[j] / ht->table.count);
+    }
+
+    printf("  longest probe %lu, %.2f keys compared per lookup\n",
+           longest + 1, probes / ht->table.count);
+}
+
+#endif  /* OPEN_ADDRESSING */
+
+
+int main(int argc, char **argv)
+{
+    FILE *input_file;
+    char *filename;
+    char **words, **misses;
+    long nwords, i;
+    int pass, use_filter;
+    long total, miss_total;
+    unsigned long nkeys, nslots;
+    clock_t start;
+    double insert_secs, lookup_secs, miss_secs, free_secs, fp_rate;
+    hash_table *ht;
+
+    use_filter = argc == 3 && strcmp(argv[1], "-b") == 0;
+
+    if (argc != 2 + use_filter)
+    {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    filename = argv[1 + use_filter];
+    input_file = fopen(filename, "r");
+
+    if (input_file == NULL)
+    {
+        fprintf(stderr, "Input file \"%s\" does not exist! "
+                        "Terminating program.\n", filename);
+        return 1;
+    }
+
+    words = read_words(input_file, &nwords);
+    fclose(input_file);
+
+    misses = (char **) malloc((nwords + 1) * sizeof(char *));
+    if (misses == NULL) out_of_memory();
+
+    for (i = 0; i < nwords; i++)
+    {
+        misses[i] = (char *) malloc(strlen(words[i]) + 2);
+        if (misses[i] == NULL) out_of_memory();
+        strcpy(misses[i], words[i]);
+        strcat(misses[i], "#");
+    }
+
+    /* Count the words, the way main.c does. */
+    ht = create_hash_table();
+    if (use_filter)
+    {
+        add_bloom_filter(ht, nwords / 100);
+    }
+    start = clock();
+
+    for (i = 0; i < nwords; i++)
+    {
+        increment_value_copy(ht, words[i]);
+    }
+
+    insert_secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+    /* Look every word up again. */
+    total = 0;
+    start = clock();
+
+    for (pass = 0; pass < LOOKUP_PASSES; pass++)
+    {
+        for (i = 0; i < nwords; i++)
+        {
+            total += get_value(ht, words[i]);
+        }
+    }
+
+    lookup_secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+    /* Look up the words that aren't there. */
+    miss_total = 0;
+    start = clock();
+
+    for (pass = 0; pass < LOOKUP_PASSES; pass++)
+    {
+        for (i = 0; i < nwords; i++)
+        {
+            miss_total += get_value(ht, misses[i]);
+        }
+    }
+
+    miss_secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+    fp_rate = use_filter ? bloom_false_positive_rate(ht->filter) : 0.0;
+
+    table_size(ht, &nkeys, &nslots);
+    print_chain_lengths(ht);
+
+    start = clock();
+    free_hash_table(ht);
+    free_secs = (double) (clock() - start) / CLOCKS_PER_SEC;
+
+    printf("%s: %ld words, %lu distinct, %lu slots\n",
+           argv[0], nwords, nkeys, nslots);
+    printf("  insert %8.3f s %12.0f words/s\n",
+           insert_secs, nwords / insert_secs);
+    printf("  lookup %8.3f s %12.0f lookups/s   (checksum %ld)\n",
+           lookup_secs, LOOKUP_PASSES * nwords / lookup_secs, total);
+    printf("  miss   %8.3f s %12.0f lookups/s   (checksum %ld)\n",
+           miss_secs, LOOKUP_PASSES * nwords / miss_secs, miss_total);
+
+    if (use_filter)
+    {
+        printf("  Bloom filter: %.2f%% false positives\n", 100.0 * fp_rate);
+    }
+    printf("  free   %8.3f s\n", free_secs);
+
+    for (i = 0; i < nwords; i++)
+    {
+        free(words[i]);
+        free(misses[i]);
+    }
+
+    free(words);
+    free(misses);
+    return 0;
+}
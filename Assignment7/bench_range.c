@@ -0,0 +1,236 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: bench_range.c
+ *
+ *       Benchmark of range queries on the word counts: the ordered
+ *       index (find_range) against scanning the whole table for the
+ *       keys in range and sorting them.  The queries are the ranges
+ *       of words starting with the first two letters of words picked
+ *       from the input ("fo" asks for "fo" up to "fp").  Also reports
+ *       what keeping the index up to date costs while counting.
+ *
+ *       usage: bench_range filename
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "hash_table.h"
+#include "tokenizer.h"
+
+#define NQUERIES     1000
+#define PREFIX_LEN   2
+
+typedef struct
+{
+    char *key;
+    int value;
+} pair;
+
+typedef struct
+{
+    char *lo, *hi;
+    pair *p;
+    size_t n;
+} scan_arg;
+
+
+void usage(char *progname)
+{
+    fprintf(stderr, "usage: %s filename\n", progname);
+}
+
+
+void out_of_memory(void)
+{
+    fprintf(stderr, "Error: memory allocation failed! "
+                    "Terminating program.\n");
+    exit(1);
+}
+
+
+double seconds_since(clock_t start)
+{
+    return (double) (clock() - start) / CLOCKS_PER_SEC;
+}
+
+
+/* Count the words of the input into 'ht'. */
+void count_words(hash_table *ht, input_file *input)
+{
+    tokenizer t;
+    char *word;
+    size_t len;
+
+    init_tokenizer(&t, input->data, input->size);
+    while (next_word(&t, &word, &len))
+    {
+        increment_value_n(ht, word, len);
+    }
+}
+
+
+void add_in_range(char *key, int value, unsigned long hash, void *arg)
+{
+    scan_arg *s;
+    s = (scan_arg *) arg;
+    if (strcmp(key, s->lo) >= 0 && strcmp(key, s->hi) < 0)
+    {
+        s->p[s->n].key = key;
+        s->p[s->n].value = value;
+        s->n++;
+    }
+}
+
+
+int by_key(const void *a, const void *b)
+{
+    return strcmp(((pair *) a)->key, ((pair *) b)->key);
+}
+
+
+/*
+ * Make the queries: the first PREFIX_LEN bytes of words spread over
+ * the input, and the same with the last byte one higher.
+ */
+void make_queries(input_file *input, char **lo, char **hi)
+{
+    tokenizer t;
+    char *word;
+    size_t len, step;
+    int q;
+
+    step = input->size / NQUERIES + 1;
+    for (q = 0; q < NQUERIES; q++)
+    {
+        init_tokenizer(&t, input->data + (q * step) % input->size,
+                       input->size - (q * step) % input->size);
+        if (!next_word(&t, &word, &len))
+        {
+            init_tokenizer(&t, input->data, input->size);
+            next_word(&t, &word, &len);
+        }
+        if (len > PREFIX_LEN)
+        {
+            len = PREFIX_LEN;
+        }
+
+        lo[q] = (char *) malloc(len + 1);
+        hi[q] = (char *) malloc(len + 1);
+        if (lo[q] == NULL || hi[q] == NULL) out_of_memory();
+        memcpy(lo[q], word, len);
+        lo[q][len] = '\0';
+        strcpy(hi[q], lo[q]);
+        hi[q][len - 1]++;
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    input_file input;
+    hash_table *plain, *indexed;
+    char *lo[NQUERIES], *hi[NQUERIES];
+    key_range r;
+    scan_arg s;
+    char *key;
+    int value, q;
+    long index_total, scan_total, found;
+    clock_t start;
+    double plain_secs, indexed_secs, index_secs, scan_secs;
+
+    if (argc != 2)
+    {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    if (open_input_file(argv[1], &input) < 0 || input.size == 0)
+    {
+        fprintf(stderr, "Input file \"%s\" does not exist or is empty! "
+                        "Terminating program.\n", argv[1]);
+        return 1;
+    }
+
+    /* Counting, without and with the index. */
+    plain = create_hash_table();
+    start = clock();
+    count_words(plain, &input);
+    plain_secs = seconds_since(start);
+
+    indexed = create_hash_table();
+    add_ordered_index(indexed);
+    start = clock();
+    count_words(indexed, &input);
+    indexed_secs = seconds_since(start);
+
+    make_queries(&input, lo, hi);
+
+    /* The queries through the index. */
+    index_total = 0;
+    found = 0;
+    start = clock();
+
+    for (q = 0; q < NQUERIES; q++)
+    {
+        find_range(indexed, lo[q], hi[q], &r);
+        while (next_in_range(&r, &key, &value))
+        {
+            index_total += value;
+            found++;
+        }
+    }
+
+    index_secs = seconds_since(start);
+
+    /* The same queries by scanning and sorting. */
+    s.p = (pair *) malloc(indexed->order->count * sizeof(pair));
+    if (s.p == NULL) out_of_memory();
+    scan_total = 0;
+    start = clock();
+
+    for (q = 0; q < NQUERIES; q++)
+    {
+        s.lo = lo[q];
+        s.hi = hi[q];
+        s.n = 0;
+        foreach_entry(plain, add_in_range, &s);
+        qsort(s.p, s.n, sizeof(pair), by_key);
+        while (s.n > 0)
+        {
+            scan_total += s.p[--s.n].value;
+        }
+    }
+
+    scan_secs = seconds_since(start);
+
+    printf("%s: %lu distinct words, %d queries, %ld keys found\n",
+           argv[0], indexed->order->count, NQUERIES, found);
+    printf("  counting        %8.3f s   (%.3f s with the index)\n",
+           plain_secs, indexed_secs);
+    printf("  index           %8.3f s %12.1f us/query\n",
+           index_secs, 1e6 * index_secs / NQUERIES);
+    printf("  scan and sort   %8.3f s %12.1f us/query\n",
+           scan_secs, 1e6 * scan_secs / NQUERIES);
+
+    if (index_total != scan_total)
+    {
+        printf("  The results differ! (%ld and %ld)\n",
+               index_total, scan_total);
+    }
+
+    for (q = 0; q < NQUERIES; q++)
+    {
+        free(lo[q]);
+        free(hi[q]);
+    }
+
+    free(s.p);
+    free_hash_table(plain);
+    free_hash_table(indexed);
+    close_input_file(&input);
+    return 0;
+}
@@ -0,0 +1,127 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: bloom.c
+ *
+ *       Implementation of the blocked Bloom filter.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "bloom.h"
+#include "memcheck.h"
+
+#define WORD_BITS   (sizeof(unsigned long) * CHAR_BIT)
+#define BLOCK_WORDS (BLOOM_BLOCK_BITS / WORD_BITS)
+
+/*
+ * The low bits of a hash pick the block, and the high half gives the
+ * bits within it: BLOOM_K of them, by double hashing (a + i * b, with
+ * b odd so the positions differ).
+ */
+#define BLOCK_OF(bf, h) ((h) & ((bf)->nblocks - 1))
+#define HIGH_HALF(h)    ((h) >> (WORD_BITS / 2))
+
+static void allocate_blocks(bloom_filter *bf, unsigned long capacity);
+
+
+/* Make room for 'capacity' keys, in whole, aligned, empty blocks. */
+static void allocate_blocks(bloom_filter *bf, unsigned long capacity)
+{
+    unsigned long nbits;
+    size_t size, pad;
+
+    nbits = capacity * BLOOM_BITS_PER_KEY;
+    bf->nblocks = 1;
+    while (bf->nblocks * BLOOM_BLOCK_BITS < nbits)
+    {
+        bf->nblocks *= 2;
+    }
+    bf->capacity = capacity;
+    bf->removed = 0;
+
+    size = bf->nblocks * BLOOM_BLOCK_BYTES;
+    bf->mem = malloc(size + BLOOM_BLOCK_BYTES);
+    if (bf->mem == NULL)
+    {
+        printf("Failed to allocate memory; exiting\n");
+        exit(1);
+    }
+    pad = (BLOOM_BLOCK_BYTES - (size_t) bf->mem % BLOOM_BLOCK_BYTES)
+          % BLOOM_BLOCK_BYTES;
+    bf->bits = (unsigned long *) ((char *) bf->mem + pad);
+    memset(bf->bits, 0, size);
+}
+
+
+void bloom_init(bloom_filter *bf, unsigned long capacity)
+{
+    allocate_blocks(bf, capacity);
+    bf->lookups = 0;
+    bf->negatives = 0;
+    bf->false_positives = 0;
+}
+
+
+void bloom_free(bloom_filter *bf)
+{
+    free(bf->mem);
+    bf->mem = NULL;
+    bf->bits = NULL;
+}
+
+
+void bloom_resize(bloom_filter *bf, unsigned long capacity)
+{
+    free(bf->mem);
+    allocate_blocks(bf, capacity);
+}
+
+
+void bloom_add(bloom_filter *bf, unsigned long hash)
+{
+    unsigned long *block, a, b, bit;
+    int i;
+
+    block = bf->bits + BLOCK_OF(bf, hash) * BLOCK_WORDS;
+    a = HIGH_HALF(hash);
+    b = (a >> 9) | 1;
+    for (i = 0; i < BLOOM_K; i++)
+    {
+        bit = (a + i * b) % BLOOM_BLOCK_BITS;
+        block[bit / WORD_BITS] |= 1UL << (bit % WORD_BITS);
+    }
+}
+
+
+int bloom_maybe_contains(bloom_filter *bf, unsigned long hash)
+{
+    unsigned long *block, a, b, bit;
+    int i;
+
+    bf->lookups++;
+    block = bf->bits + BLOCK_OF(bf, hash) * BLOCK_WORDS;
+    a = HIGH_HALF(hash);
+    b = (a >> 9) | 1;
+    for (i = 0; i < BLOOM_K; i++)
+    {
+        bit = (a + i * b) % BLOOM_BLOCK_BITS;
+        if ((block[bit / WORD_BITS] & (1UL << (bit % WORD_BITS))) == 0)
+        {
+            bf->negatives++;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+double bloom_false_positive_rate(bloom_filter *bf)
+{
+    unsigned long misses;
+    misses = bf->negatives + bf->false_positives;
+    return misses == 0 ? 0.0 : (double) bf->false_positives / misses;
+}
@@ -0,0 +1,68 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: bloom.h
+ *
+ *       A blocked Bloom filter over key hashes, which a hash table can
+ *       put in front of its lookups to answer most misses without
+ *       looking at its slots.
+ *
+ */
+
+#ifndef BLOOM_H
+#define BLOOM_H
+
+/*
+ * The filter is an array of blocks of one cache line each.  A key's
+ * hash picks a block and sets BLOOM_K bits in it, so testing a key
+ * reads one cache line.  BLOOM_BITS_PER_KEY bits of filter per key
+ * give about 1% false positives at full capacity.
+ */
+#define BLOOM_BLOCK_BYTES  64
+#define BLOOM_BLOCK_BITS   (BLOOM_BLOCK_BYTES * 8)
+#define BLOOM_K            7
+#define BLOOM_BITS_PER_KEY 10
+
+typedef struct
+{
+    unsigned long *bits;        /* nblocks blocks, cache line aligned */
+    void *mem;                  /* the allocation 'bits' is in        */
+    unsigned long nblocks;      /* a power of two                     */
+    unsigned long capacity;     /* keys it was sized for              */
+    unsigned long removed;      /* keys added, then taken out of the
+                                   table (the filter still has them)  */
+
+    /* What it was asked and how it did. */
+    unsigned long lookups;          /* keys tested                    */
+    unsigned long negatives;        /* answered "not there"           */
+    unsigned long false_positives;  /* "maybe", but the key was new   */
+} bloom_filter;
+
+/* Set up an empty filter sized for 'capacity' keys. */
+void bloom_init(bloom_filter *bf, unsigned long capacity);
+
+void bloom_free(bloom_filter *bf);
+
+/*
+ * Empty the filter and resize it for 'capacity' keys.  The counts of
+ * lookups are kept; 'removed' starts again from 0.
+ */
+void bloom_resize(bloom_filter *bf, unsigned long capacity);
+
+/* Add a key by its hash. */
+void bloom_add(bloom_filter *bf, unsigned long hash);
+
+/*
+ * Return 0 if the key with this hash is certainly not in the filter,
+ * 1 if it may be.  Counts the lookup, and the negative.
+ */
+int bloom_maybe_contains(bloom_filter *bf, unsigned long hash);
+
+/*
+ * The fraction of keys not in the filter that it let through, from
+ * the lookups so far (for this the table counts each "maybe" that
+ * turned out to be a miss in 'false_positives').
+ */
+double bloom_false_positive_rate(bloom_filter *bf);
+
+#endif  /* BLOOM_H */
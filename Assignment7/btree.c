@@ -0,0 +1,430 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: btree.c
+ *
+ *       Implementation of the B-tree of strings.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include "btree.h"
+#include "memcheck.h"
+
+static btree_node *create_btree_node(btree *t, int leaf);
+static int lower_bound(btree_node *n, char *key);
+static void split_child(btree *t, btree_node *parent, int i);
+static void push_leftmost(btree_cursor *c, btree_node *n);
+static void release_node(btree *t, btree_node *n);
+static void merge_children(btree *t, btree_node *parent, int i);
+static int fill_child(btree *t, btree_node *parent, int i);
+
+
+static btree_node *create_btree_node(btree *t, int leaf)
+{
+    btree_node *n;
+    if (t->spare[leaf] != NULL)
+    {
+        n = t->spare[leaf];
+        t->spare[leaf] = (btree_node *) n->key[0];
+    }
+    else
+    {
+        n = (btree_node *) arena_alloc(&t->mem, leaf
+                                       ? offsetof(btree_node, child)
+                                       : sizeof(btree_node));
+    }
+    n->nkeys = 0;
+    n->leaf = leaf;
+    return n;
+}
+
+
+void btree_init(btree *t)
+{
+    t->root = NULL;
+    t->count = 0;
+    arena_init(&t->mem);
+    t->spare[0] = NULL;
+    t->spare[1] = NULL;
+}
+
+
+/* The nodes all live in the arena; the keys belong to someone else. */
+void btree_free(btree *t)
+{
+    arena_free(&t->mem);
+    t->root = NULL;
+    t->count = 0;
+    t->spare[0] = NULL;
+    t->spare[1] = NULL;
+}
+
+
+/* Keep an unused node for reuse, linked through its first key. */
+static void release_node(btree *t, btree_node *n)
+{
+    n->key[0] = (char *) t->spare[n->leaf];
+    t->spare[n->leaf] = n;
+}
+
+
+/* The index of the first key of 'n' not less than 'key'. */
+static int lower_bound(btree_node *n, char *key)
+{
+    int lo, hi, mid;
+    lo = 0;
+    hi = n->nkeys;
+    while (lo < hi)
+    {
+        mid = (lo + hi) / 2;
+        if (strcmp(n->key[mid], key) < 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+
+/*
+ * Split the full child 'i' of 'parent' in two around its middle key,
+ * which moves up into 'parent' (which has room for it).
+ */
+static void split_child(btree *t, btree_node *parent, int i)
+{
+    btree_node *full, *right;
+    int mid;
+
+    full = parent->child[i];
+    right = create_btree_node(t, full->leaf);
+    mid = BTREE_MIN_DEGREE - 1;
+
+    right->nkeys = BTREE_MAX_KEYS - mid - 1;
+    memcpy(right->key, full->key + mid + 1, right->nkeys * sizeof(char *));
+    if (!full->leaf)
+    {
+        memcpy(right->child, full->child + mid + 1,
+               (right->nkeys + 1) * sizeof(btree_node *));
+    }
+    full->nkeys = mid;
+
+    memmove(parent->key + i + 1, parent->key + i,
+            (parent->nkeys - i) * sizeof(char *));
+    memmove(parent->child + i + 2, parent->child + i + 1,
+            (parent->nkeys - i) * sizeof(btree_node *));
+    parent->key[i] = full->key[mid];
+    parent->child[i + 1] = right;
+    parent->nkeys++;
+}
+
+
+/*
+ * Insert on the way down: any full node on the path is split before
+ * it is entered, so there is always room for a key coming up.
+ */
+void btree_insert(btree *t, char *key)
+{
+    btree_node *n, *root;
+    int i;
+
+    if (t->root == NULL)
+    {
+        t->root = create_btree_node(t, 1);
+    }
+
+    if (t->root->nkeys == BTREE_MAX_KEYS)
+    {
+        root = create_btree_node(t, 0);
+        root->child[0] = t->root;
+        t->root = root;
+        split_child(t, root, 0);
+    }
+
+    n = t->root;
+    while (!n->leaf)
+    {
+        i = lower_bound(n, key);
+        if (n->child[i]->nkeys == BTREE_MAX_KEYS)
+        {
+            split_child(t, n, i);
+            if (strcmp(n->key[i], key) < 0)
+            {
+                i++;
+            }
+        }
+        n = n->child[i];
+    }
+
+    i = lower_bound(n, key);
+    memmove(n->key + i + 1, n->key + i, (n->nkeys - i) * sizeof(char *));
+    n->key[i] = key;
+    n->nkeys++;
+    t->count++;
+}
+
+
+/*
+ * Merge child 'i + 1' of 'parent', and the key between the two, into
+ * child 'i'.  Both children have BTREE_MIN_DEGREE - 1 keys, so the
+ * merged one is full.
+ */
+static void merge_children(btree *t, btree_node *parent, int i)
+{
+    btree_node *left, *right;
+
+    left = parent->child[i];
+    right = parent->child[i + 1];
+
+    left->key[left->nkeys] = parent->key[i];
+    memcpy(left->key + left->nkeys + 1, right->key,
+           right->nkeys * sizeof(char *));
+    if (!left->leaf)
+    {
+        memcpy(left->child + left->nkeys + 1, right->child,
+               (right->nkeys + 1) * sizeof(btree_node *));
+    }
+    left->nkeys += right->nkeys + 1;
+
+    memmove(parent->key + i, parent->key + i + 1,
+            (parent->nkeys - i - 1) * sizeof(char *));
+    memmove(parent->child + i + 1, parent->child + i + 2,
+            (parent->nkeys - i - 1) * sizeof(btree_node *));
+    parent->nkeys--;
+    release_node(t, right);
+}
+
+
+/*
+ * Make sure child 'i' of 'parent' has a key to spare before a removal
+ * goes down into it: move one over through the parent from a sibling
+ * that has one to spare, or else merge it with a sibling.  Returns
+ * the index the child has now (one less if it merged into its left
+ * sibling).
+ */
+static int fill_child(btree *t, btree_node *parent, int i)
+{
+    btree_node *c, *s;
+
+    c = parent->child[i];
+    if (c->nkeys >= BTREE_MIN_DEGREE)
+    {
+        return i;
+    }
+
+    if (i > 0 && parent->child[i - 1]->nkeys >= BTREE_MIN_DEGREE)
+    {
+        /* the left sibling's last key goes up, the parent's comes down */
+        s = parent->child[i - 1];
+        memmove(c->key + 1, c->key, c->nkeys * sizeof(char *));
+        c->key[0] = parent->key[i - 1];
+        if (!c->leaf)
+        {
+            memmove(c->child + 1, c->child,
+                    (c->nkeys + 1) * sizeof(btree_node *));
+            c->child[0] = s->child[s->nkeys];
+        }
+        parent->key[i - 1] = s->key[s->nkeys - 1];
+        s->nkeys--;
+        c->nkeys++;
+        return i;
+    }
+
+    if (i < parent->nkeys && parent->child[i + 1]->nkeys >= BTREE_MIN_DEGREE)
+    {
+        /* the same from the right sibling's first key */
+        s = parent->child[i + 1];
+        c->key[c->nkeys] = parent->key[i];
+        if (!c->leaf)
+        {
+            c->child[c->nkeys + 1] = s->child[0];
+            memmove(s->child, s->child + 1, s->nkeys * sizeof(btree_node *));
+        }
+        parent->key[i] = s->key[0];
+        memmove(s->key, s->key + 1, (s->nkeys - 1) * sizeof(char *));
+        s->nkeys--;
+        c->nkeys++;
+        return i;
+    }
+
+    if (i < parent->nkeys)
+    {
+        merge_children(t, parent, i);
+        return i;
+    }
+    merge_children(t, parent, i - 1);
+    return i - 1;
+}
+
+
+/*
+ * Remove on the way down, the mirror image of inserting: every node
+ * entered has a key to spare, so taking one out of a leaf never
+ * leaves it too small.  A key found in an inner node is replaced by
+ * its predecessor or successor, which is then removed from the leaf
+ * it is in, or the two children around it are merged.
+ */
+int btree_remove(btree *t, char *key)
+{
+    btree_node *n, *c;
+    int i, found;
+
+    if (t->root == NULL)
+    {
+        return 0;
+    }
+
+    n = t->root;
+    for ( ; ; )
+    {
+        i = lower_bound(n, key);
+        found = i < n->nkeys && strcmp(n->key[i], key) == 0;
+
+        if (n->leaf)
+        {
+            if (!found)
+            {
+                return 0;
+            }
+            memmove(n->key + i, n->key + i + 1,
+                    (n->nkeys - i - 1) * sizeof(char *));
+            n->nkeys--;
+            break;
+        }
+
+        if (found && n->child[i]->nkeys >= BTREE_MIN_DEGREE)
+        {
+            /* the largest key below it takes its place */
+            for (c = n->child[i]; !c->leaf; c = c->child[c->nkeys])
+                ;
+            key = n->key[i] = c->key[c->nkeys - 1];
+            n = n->child[i];
+            continue;
+        }
+
+        if (found && n->child[i + 1]->nkeys >= BTREE_MIN_DEGREE)
+        {
+            /* or the smallest key above it */
+            for (c = n->child[i + 1]; !c->leaf; c = c->child[0])
+                ;
+            key = n->key[i] = c->key[0];
+            n = n->child[i + 1];
+            continue;
+        }
+
+        /* merge the key into a child, or make the child big enough */
+        if (found)
+        {
+            merge_children(t, n, i);
+        }
+        else
+        {
+            i = fill_child(t, n, i);
+        }
+
+        c = n->child[i];
+        if (n->nkeys == 0)
+        {
+            /* the root's last key went down: the tree gets shorter */
+            t->root = c;
+            release_node(t, n);
+        }
+        n = c;
+    }
+
+    t->count--;
+    if (t->root->nkeys == 0)
+    {
+        release_node(t, t->root);
+        t->root = NULL;
+    }
+    return 1;
+}
+
+
+/*** Cursors. ***/
+
+/* Push the path from 'n' down to its first key. */
+static void push_leftmost(btree_cursor *c, btree_node *n)
+{
+    for ( ; ; )
+    {
+        c->node[c->depth] = n;
+        c->pos[c->depth] = 0;
+        c->depth++;
+        if (n->leaf)
+        {
+            return;
+        }
+        n = n->child[0];
+    }
+}
+
+
+void btree_seek(btree *t, btree_cursor *c, char *key)
+{
+    btree_node *n;
+    int i;
+
+    c->depth = 0;
+    if (t->root == NULL)
+    {
+        return;
+    }
+
+    if (key == NULL)
+    {
+        push_leftmost(c, t->root);
+        return;
+    }
+
+    for (n = t->root; ; n = n->child[i])
+    {
+        i = lower_bound(n, key);
+        c->node[c->depth] = n;
+        c->pos[c->depth] = i;
+        c->depth++;
+        if (n->leaf)
+        {
+            return;
+        }
+    }
+}
+
+
+char *btree_next(btree_cursor *c)
+{
+    btree_node *n;
+    char *key;
+    int i;
+
+    while (c->depth > 0)
+    {
+        n = c->node[c->depth - 1];
+        i = c->pos[c->depth - 1];
+
+        if (i < n->nkeys)
+        {
+            key = n->key[i];
+            c->pos[c->depth - 1] = i + 1;
+            if (!n->leaf)
+            {
+                /* the keys of the next child come after this one */
+                push_leftmost(c, n->child[i + 1]);
+            }
+            return key;
+        }
+
+        /* this node is done; go back up */
+        c->depth--;
+    }
+
+    return NULL;
+}
@@ -0,0 +1,89 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: btree.h
+ *
+ *       A B-tree of strings in strcmp order, used as an ordered index
+ *       of a hash table's keys.  The tree stores pointers to the keys,
+ *       which must stay put for as long as the tree is used (the
+ *       tables keep their keys in an arena, so they do).
+ *
+ */
+
+#ifndef BTREE_H
+#define BTREE_H
+
+#include "arena.h"
+
+/*
+ * Every node but the root holds from BTREE_MIN_DEGREE - 1 to
+ * 2 * BTREE_MIN_DEGREE - 1 keys.  A node of 31 key pointers is four
+ * cache lines, which a lookup binary searches.
+ */
+#define BTREE_MIN_DEGREE 16
+#define BTREE_MAX_KEYS   (2 * BTREE_MIN_DEGREE - 1)
+
+/*
+ * Deep enough for any tree that fits in memory: with at least 16
+ * children per node, 16 levels hold more than 2^60 keys.
+ */
+#define BTREE_MAX_DEPTH  16
+
+/*
+ * A node.  Leaves are allocated without the 'child' array, which they
+ * never use.
+ */
+
+typedef struct _btree_node
+{
+    int nkeys;
+    int leaf;
+    char *key[BTREE_MAX_KEYS];
+    struct _btree_node *child[BTREE_MAX_KEYS + 1];
+} btree_node;
+
+typedef struct
+{
+    btree_node *root;
+    unsigned long count;        /* number of keys in the tree */
+    arena mem;                  /* the nodes                  */
+    btree_node *spare[2];       /* emptied inner nodes and
+                                   leaves, for reuse          */
+} btree;
+
+/*
+ * A position in the tree, for walking the keys in order.  The stack
+ * holds the path from the root: at a leaf, 'pos' is the next key to
+ * return; at an inner node, it is the child being walked, and the
+ * key of the same index comes after it.
+ */
+
+typedef struct
+{
+    btree_node *node[BTREE_MAX_DEPTH];
+    int pos[BTREE_MAX_DEPTH];
+    int depth;                  /* 0 once the walk is over */
+} btree_cursor;
+
+void btree_init(btree *t);
+void btree_free(btree *t);
+
+/* Add a key, which must not be in the tree already. */
+void btree_insert(btree *t, char *key);
+
+/*
+ * Take a key out of the tree.  Returns 1 if it was there, 0 if not.
+ * Nodes emptied by merging are kept for later inserts.
+ */
+int btree_remove(btree *t, char *key);
+
+/*
+ * Point a cursor at the first key not less than 'key', or at the
+ * first key of all if 'key' is NULL.
+ */
+void btree_seek(btree *t, btree_cursor *c, char *key);
+
+/* Return the cursor's key and move on, or return NULL at the end. */
+char *btree_next(btree_cursor *c);
+
+#endif  /* BTREE_H */
@@ -0,0 +1,365 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: cache_test.c
+ *
+ *       Test of removing keys and of expiry times, on a table used as
+ *       a cache.  Random updates, removals, expiry times and lookups
+ *       of a fixed set of keys (short ones, kept inline, and long
+ *       ones) are made on the table and on arrays that say what it
+ *       should hold, and the two are compared along the way: by
+ *       lookups, by walking the table and by a range query.  This is
+ *       done on a plain table and on one with a Bloom filter and an
+ *       ordered index, and the table must not grow while its keys
+ *       come and go.  Last, a stream of new keys goes through a small
+ *       table, taken out again by remove_key or by expiring, and the
+ *       memory the table uses (its keys included) must stay flat.
+ *
+ *       usage: cache_test
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hash_table.h"
+#include "memcheck.h"
+
+#define NKEYS       2000
+#define NOPS        400000
+#define CHECK_EVERY 5000    /* operations between walks of the table */
+#define MAX_TTL     50
+#define KEY_LENGTH  40
+#define CHURN_KEYS  100000  /* new keys in the churn test             */
+#define CHURN_LIVE  100     /* ... of which this many are kept at once */
+#define CHURN_WARM  1000    /* keys before the memory is measured     */
+
+/* What the table should hold. */
+typedef struct
+{
+    int value[NKEYS];               /* 0 if the key isn't there */
+    unsigned long expires[NKEYS];   /* 0 if it never does       */
+    unsigned long now;
+} reference;
+
+typedef struct
+{
+    reference *ref;
+    unsigned long seen;
+    int errors;
+} walk_arg;
+
+
+/* A simple generator, so every run does the same. */
+unsigned long next_random(unsigned long *state)
+{
+    *state = *state * 6364136223846793005UL + 1442695040888963407UL;
+    return *state >> 17;
+}
+
+
+/* Even keys are short, odd ones too long to be kept inline. */
+void make_key(char *key, int i)
+{
+    if (i % 2 == 0)
+    {
+        sprintf(key, "k%d", i);
+    }
+    else
+    {
+        sprintf(key, "a rather longer key %d", i);
+    }
+}
+
+
+/* The number of a key made by make_key. */
+int key_number(char *key)
+{
+    return atoi(key + strcspn(key, "0123456789"));
+}
+
+
+/* Forget the reference's key 'i' if its time has come. */
+void expire(reference *ref, int i)
+{
+    if (ref->expires[i] != 0 && ref->expires[i] <= ref->now)
+    {
+        ref->value[i] = 0;
+        ref->expires[i] = 0;
+    }
+}
+
+
+void check_entry(char *key, int value, unsigned long hash, void *arg)
+{
+    walk_arg *w;
+    int i;
+
+    w = (walk_arg *) arg;
+    i = key_number(key);
+    expire(w->ref, i);
+    if (w->ref->value[i] != value)
+    {
+        w->errors++;
+    }
+    w->seen++;
+}
+
+
+/* Compare all of the table with the reference. */
+int check_table(hash_table *ht, reference *ref)
+{
+    walk_arg w;
+    key_range r;
+    char *key, lo[KEY_LENGTH];
+    int i, value, errors;
+    unsigned long live, in_range;
+
+    w.ref = ref;
+    w.seen = 0;
+    w.errors = 0;
+    foreach_entry(ht, check_entry, &w);
+    errors = w.errors;
+
+    /* the short keys from "k1" on, by the index */
+    live = 0;
+    in_range = 0;
+    for (i = 0; i < NKEYS; i++)
+    {
+        expire(ref, i);
+        if (ref->value[i] != 0)
+        {
+            live++;
+            make_key(lo, i);
+            if (i % 2 == 0 && strcmp(lo, "k1") >= 0)
+            {
+                in_range++;
+            }
+        }
+    }
+
+    find_range(ht, "k1", NULL, &r);
+    while (next_in_range(&r, &key, &value))
+    {
+        if (key[0] != 'k' || ref->value[key_number(key)] != value)
+        {
+            errors++;
+        }
+        in_range--;
+    }
+
+    if (w.seen != live || in_range != 0)
+    {
+        errors++;
+    }
+    return errors;
+}
+
+
+/* Run the random operations on 'ht', returning the errors found. */
+int run(hash_table *ht, reference *ref)
+{
+    table_stats s;
+    char key[KEY_LENGTH];
+    unsigned long state, r, when, nslots;
+    long op;
+    int i, errors;
+
+    errors = 0;
+    state = 1;
+    nslots = 0;
+
+    for (op = 0; op < NOPS; op++)
+    {
+        r = next_random(&state);
+        i = (int) (r % NKEYS);
+        r /= NKEYS;
+        make_key(key, i);
+        expire(ref, i);
+
+        switch (r % 10)
+        {
+        case 0: case 1: case 2: case 3:
+            if (increment_value_copy(ht, key) != ++ref->value[i])
+            {
+                errors++;
+            }
+            break;
+
+        case 4:
+            if (remove_key(ht, key) != (ref->value[i] != 0))
+            {
+                errors++;
+            }
+            ref->value[i] = 0;
+            ref->expires[i] = 0;
+            break;
+
+        case 5:
+            when = r % 4 == 0 ? 0 : ref->now + 1 + r / 4 % MAX_TTL;
+            if (set_expiry(ht, key, when) != (ref->value[i] != 0))
+            {
+                errors++;
+            }
+            if (ref->value[i] != 0)
+            {
+                ref->expires[i] = when;
+            }
+            break;
+
+        case 6:
+            if (get_value(ht, key) != ref->value[i])
+            {
+                errors++;
+            }
+            break;
+
+        case 7:
+            ref->now++;
+            set_clock(ht, ref->now);
+            break;
+
+        case 8:
+            expire_keys(ht, r / 10 % 32);
+            break;
+
+        default:
+            set_value(ht, strcpy((char *) malloc(strlen(key) + 1), key),
+                      ref->value[i] + 1);
+            ref->value[i]++;
+            break;
+        }
+
+        if ((op + 1) % CHECK_EVERY == 0)
+        {
+            errors += check_table(ht, ref);
+
+            /* every key has come and gone by now: no more growth */
+            hash_table_stats(ht, &s);
+            if (nslots == 0 && op + 1 >= NOPS / 4)
+            {
+                nslots = s.nslots;
+            }
+            else if (nslots != 0 && s.nslots > nslots)
+            {
+                errors++;
+            }
+        }
+    }
+
+    return errors;
+}
+
+
+/*
+ * Send CHURN_KEYS new keys, too long to be kept inline, through a
+ * table that holds CHURN_LIVE of them at a time: taken out with
+ * remove_key, or if 'expiring' left to expire.  Returns the errors.
+ */
+int churn(int expiring)
+{
+    hash_table *ht;
+    table_stats s;
+    char key[KEY_LENGTH];
+    size_t warm_bytes;
+    long j;
+    int errors;
+
+    ht = create_hash_table();
+    errors = 0;
+    warm_bytes = 0;
+
+    for (j = 0; j < CHURN_KEYS; j++)
+    {
+        sprintf(key, "a churning key %08ld", j);
+        increment_value_copy(ht, key);
+        if (expiring)
+        {
+            set_clock(ht, (unsigned long) j);
+            set_expiry(ht, key, (unsigned long) (j + CHURN_LIVE));
+        }
+        else if (j >= CHURN_LIVE)
+        {
+            sprintf(key, "a churning key %08ld", j - CHURN_LIVE);
+            if (remove_key(ht, key) != 1)
+            {
+                errors++;
+            }
+        }
+
+        if (j == CHURN_WARM || j == CHURN_KEYS - 1)
+        {
+            hash_table_stats(ht, &s);
+            if (j == CHURN_WARM)
+            {
+                warm_bytes = s.bytes;
+            }
+            /* removing keys keeps exactly as many: not a byte more */
+            else if (expiring ? s.bytes > 2 * warm_bytes
+                              : s.bytes != warm_bytes)
+            {
+                fprintf(stderr, "churn: %lu bytes at first, %lu at the "
+                        "end\n", (unsigned long) warm_bytes,
+                        (unsigned long) s.bytes);
+                errors++;
+            }
+            if (s.count > 2 * CHURN_LIVE)
+            {
+                errors++;
+            }
+        }
+    }
+
+    free_hash_table(ht);
+    return errors;
+}
+
+
+int main(int argc, char **argv)
+{
+    hash_table *ht;
+    reference *ref;
+    int errors;
+
+    if (argc != 1)
+    {
+        fprintf(stderr, "usage: %s\n", argv[0]);
+        exit(1);
+    }
+
+    ref = (reference *) calloc(1, sizeof(reference));
+    if (ref == NULL)
+    {
+        fprintf(stderr, "Error: memory allocation failed! "
+                        "Terminating program.\n");
+        exit(1);
+    }
+
+    ht = create_hash_table();
+    errors = run(ht, ref);
+    free_hash_table(ht);
+
+    /* again, with a filter too small to start with and an index */
+    memset(ref, 0, sizeof(reference));
+    ht = create_hash_table();
+    add_bloom_filter(ht, NKEYS / 8);
+    add_ordered_index(ht);
+    errors += run(ht, ref);
+    free_hash_table(ht);
+
+    errors += churn(0);
+    errors += churn(1);
+
+    if (errors > 0)
+    {
+        printf("Cache test failed! (%s, %d errors)\n", argv[0], errors);
+    }
+    else
+    {
+        printf("Cache test succeeded! (%s)\n", argv[0]);
+    }
+
+    free(ref);
+    print_memory_leaks();
+    return errors > 0 ? 1 : 0;
+}
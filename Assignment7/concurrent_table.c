@@ -0,0 +1,291 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: concurrent_table.c
+ *
+ *       Implementation of the concurrent hash table.  C89 has no
+ *       atomics, so this uses the GCC __atomic and __sync builtins.
+ *
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include "concurrent_table.h"
+#include "memcheck.h"
+
+#define SPINS_BEFORE_YIELD 100
+
+#define LOAD(p)        __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE(p, v)    __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+static void memory_fail(void);
+static ct_slots *create_ct_slots(unsigned long nslots, ct_slots *older);
+static void lock_stripe(ct_stripe *st);
+static void unlock_stripe(ct_stripe *st);
+static ct_entry *find_entry(ct_slots *a, char *key, size_t len,
+                            unsigned long h);
+static ct_entry *insert_entry(concurrent_table *ct, char *key, size_t len,
+                              unsigned long h);
+static void grow(concurrent_table *ct);
+
+
+static void memory_fail(void)
+{
+    printf("Failed to allocate memory; exiting\n");
+    exit(1);
+}
+
+
+static ct_slots *create_ct_slots(unsigned long nslots, ct_slots *older)
+{
+    ct_slots *a;
+    a = (ct_slots *) malloc(sizeof(ct_slots));
+    if (a == NULL) memory_fail();
+    a->slot = (ct_cell **) calloc(nslots, sizeof(ct_cell *));
+    if (a->slot == NULL) memory_fail();
+    a->nslots = nslots;
+    a->older = older;
+    return a;
+}
+
+
+concurrent_table *create_concurrent_table(void)
+{
+    concurrent_table *ct;
+    int i;
+    ct = (concurrent_table *) malloc(sizeof(concurrent_table));
+    if (ct == NULL) memory_fail();
+    ct->slots = create_ct_slots(NSLOTS, NULL);
+    ct->count = 0;
+    ct->seed = hash_seed();
+    for (i = 0; i < CT_NSTRIPES; i++)
+    {
+        ct->stripe[i].s.lock = 0;
+        arena_init(&ct->stripe[i].s.mem);
+    }
+    arena_init(&ct->resize_mem);
+    ct->resizing = 0;
+    return ct;
+}
+
+
+void free_concurrent_table(concurrent_table *ct)
+{
+    ct_slots *a, *older;
+    int i;
+    for (a = ct->slots; a != NULL; a = older)
+    {
+        older = a->older;
+        free(a->slot);
+        free(a);
+    }
+    for (i = 0; i < CT_NSTRIPES; i++)
+    {
+        arena_free(&ct->stripe[i].s.mem);
+    }
+    arena_free(&ct->resize_mem);
+    free(ct);
+}
+
+
+/*** Locks. ***/
+
+static void lock_stripe(ct_stripe *st)
+{
+    int spins;
+    spins = 0;
+    while (__sync_lock_test_and_set(&st->s.lock, 1))
+    {
+        /* wait for it to look free before trying again */
+        while (__atomic_load_n(&st->s.lock, __ATOMIC_RELAXED))
+        {
+            if (++spins == SPINS_BEFORE_YIELD)
+            {
+                sched_yield();
+                spins = 0;
+            }
+        }
+    }
+}
+
+
+static void unlock_stripe(ct_stripe *st)
+{
+    __sync_lock_release(&st->s.lock);
+}
+
+
+/*** Lookups. ***/
+
+/* Find a key's entry in the slot array 'a', without locking. */
+static ct_entry *find_entry(ct_slots *a, char *key, size_t len,
+                            unsigned long h)
+{
+    ct_cell *c;
+    ct_entry *e;
+    for (c = LOAD(&a->slot[h & (a->nslots - 1)]); c != NULL; c = c->next)
+    {
+        e = c->entry;
+        if (e->hash == h && strncmp(e->key, key, len) == 0
+            && e->key[len] == '\0')
+        {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+
+int concurrent_get_value(concurrent_table *ct, char *key, size_t len)
+{
+    ct_entry *e;
+    e = find_entry(LOAD(&ct->slots), key, len,
+                   hash_n(key, len, ct->seed));
+    return e == NULL ? 0 : __atomic_load_n(&e->value, __ATOMIC_RELAXED);
+}
+
+
+/*** Updates. ***/
+
+/*
+ * Add a key, unless another thread got there first.  Holding the
+ * stripe lock keeps other inserts of the key and resizes out, so the
+ * array loaded under it stays current until the lock is dropped.
+ */
+static ct_entry *insert_entry(concurrent_table *ct, char *key, size_t len,
+                              unsigned long h)
+{
+    ct_stripe *st;
+    ct_slots *a;
+    ct_entry *e;
+    ct_cell *c, **chain;
+
+    st = &ct->stripe[h & (CT_NSTRIPES - 1)];
+    lock_stripe(st);
+
+    a = LOAD(&ct->slots);
+    e = find_entry(a, key, len, h);
+    if (e == NULL)
+    {
+        e = (ct_entry *) arena_alloc(&st->s.mem, sizeof(ct_entry));
+        e->hash = h;
+        e->key = arena_strdup(&st->s.mem, key, len);
+        e->value = 0;
+
+        c = (ct_cell *) arena_alloc(&st->s.mem, sizeof(ct_cell));
+        c->entry = e;
+        chain = &a->slot[h & (a->nslots - 1)];
+        c->next = *chain;
+        STORE(chain, c);    /* publish the cell only once it's built */
+
+        __atomic_fetch_add(&ct->count, 1, __ATOMIC_RELAXED);
+    }
+
+    unlock_stripe(st);
+    return e;
+}
+
+
+int concurrent_add_value(concurrent_table *ct, char *key, size_t len,
+                         int delta)
+{
+    ct_entry *e;
+    unsigned long h;
+
+    h = hash_n(key, len, ct->seed);
+    e = find_entry(LOAD(&ct->slots), key, len, h);
+
+    if (e == NULL)
+    {
+        e = insert_entry(ct, key, len, h);
+
+        if (__atomic_load_n(&ct->count, __ATOMIC_RELAXED)
+            > CT_MAX_LOAD * LOAD(&ct->slots)->nslots)
+        {
+            grow(ct);
+        }
+    }
+
+    return __atomic_add_fetch(&e->value, delta, __ATOMIC_RELAXED);
+}
+
+
+/*
+ * Double the slot array.  Only one thread grows at a time; the others
+ * carry on.  Taking every stripe lock stops inserts while the cells
+ * are copied, but lookups and updates of existing keys go on through
+ * the old array, which stays valid.
+ */
+static void grow(concurrent_table *ct)
+{
+    ct_slots *a, *b;
+    ct_cell *c, *nc;
+    unsigned long i;
+    int s;
+
+    if (!__sync_bool_compare_and_swap(&ct->resizing, 0, 1))
+    {
+        return;
+    }
+
+    for (s = 0; s < CT_NSTRIPES; s++)
+    {
+        lock_stripe(&ct->stripe[s]);
+    }
+
+    a = ct->slots;
+    if (ct->count > CT_MAX_LOAD * a->nslots)
+    {
+        b = create_ct_slots(2 * a->nslots, a);
+        for (i = 0; i < a->nslots; i++)
+        {
+            for (c = a->slot[i]; c != NULL; c = c->next)
+            {
+                nc = (ct_cell *) arena_alloc(&ct->resize_mem,
+                                             sizeof(ct_cell));
+                nc->entry = c->entry;
+                nc->next = b->slot[c->entry->hash & (b->nslots - 1)];
+                b->slot[c->entry->hash & (b->nslots - 1)] = nc;
+            }
+        }
+        STORE(&ct->slots, b);
+    }
+
+    for (s = CT_NSTRIPES - 1; s >= 0; s--)
+    {
+        unlock_stripe(&ct->stripe[s]);
+    }
+
+    __sync_lock_release(&ct->resizing);
+}
+
+
+/*** Walking. ***/
+
+unsigned long concurrent_count(concurrent_table *ct)
+{
+    return __atomic_load_n(&ct->count, __ATOMIC_RELAXED);
+}
+
+
+void foreach_concurrent_entry(concurrent_table *ct, entry_visitor visit,
+                              void *arg)
+{
+    ct_slots *a;
+    ct_cell *c;
+    unsigned long i;
+    a = LOAD(&ct->slots);
+    for (i = 0; i < a->nslots; i++)
+    {
+        for (c = LOAD(&a->slot[i]); c != NULL; c = c->next)
+        {
+            visit(c->entry->key,
+                  __atomic_load_n(&c->entry->value, __ATOMIC_RELAXED),
+                  c->entry->hash, arg);
+        }
+    }
+}
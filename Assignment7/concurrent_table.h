@@ -0,0 +1,110 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: concurrent_table.h
+ *
+ *       A string -> int hash table that many threads can read and
+ *       update at once.
+ *
+ */
+
+#ifndef CONCURRENT_TABLE_H
+#define CONCURRENT_TABLE_H
+
+#include <stddef.h>
+#include "arena.h"
+#include "hash_table.h"
+
+#define CT_NSTRIPES   64    /* Insert locks (a power of two).         */
+#define CT_MAX_LOAD   1     /* Keys per slot before the table grows.  */
+#define CACHE_LINE    64
+
+/*
+ * How it works:
+ *
+ * Keys live in entries holding the hash, the key and the value.  An
+ * entry never moves and is never freed before the table, so a value
+ * can be updated with an atomic add from any thread without a lock.
+ *
+ * Each slot holds a chain of cells pointing at entries.  A new cell is
+ * only ever pushed on the front of a chain, fully built, with a
+ * release store; readers follow the chains with acquire loads and no
+ * locks at all.
+ *
+ * Adding a key takes the spinlock of its stripe (chosen by hash, the
+ * same at every table size), so inserts into different stripes run in
+ * parallel.  Each stripe has its own arena for its entries and cells.
+ *
+ * Growing takes every stripe lock, builds a new slot array of new
+ * cells pointing at the same entries and publishes it with a release
+ * store.  Lookups and updates of existing keys never wait for it:
+ * they carry on through whichever array they loaded.  Old arrays and
+ * cells are kept until the table is freed.
+ */
+
+typedef struct
+{
+    unsigned long hash;
+    char *key;
+    int value;
+} ct_entry;
+
+typedef struct _ct_cell
+{
+    ct_entry *entry;
+    struct _ct_cell *next;
+} ct_cell;
+
+typedef struct _ct_slots
+{
+    unsigned long nslots;       /* a power of two                 */
+    ct_cell **slot;
+    struct _ct_slots *older;    /* arrays replaced by this one    */
+} ct_slots;
+
+typedef union
+{
+    struct
+    {
+        int lock;
+        arena mem;              /* entries, keys and cells        */
+    } s;
+    char pad[CACHE_LINE];       /* one stripe per cache line      */
+} ct_stripe;
+
+typedef struct
+{
+    ct_slots *slots;            /* the current slot array         */
+    unsigned long count;        /* number of keys                 */
+    unsigned long seed;
+    ct_stripe stripe[CT_NSTRIPES];
+    arena resize_mem;           /* cells of the grown arrays      */
+    int resizing;               /* nonzero while a thread grows   */
+} concurrent_table;
+
+concurrent_table *create_concurrent_table(void);
+
+/* Free a table.  No other thread may be using it. */
+void free_concurrent_table(concurrent_table *ct);
+
+/* Return the value stored at the 'len' bytes at 'key', or 0. */
+int concurrent_get_value(concurrent_table *ct, char *key, size_t len);
+
+/*
+ * Add 'delta' to the value stored at a key, adding a copy of the key
+ * with the value 0 first if need be.  Returns the new value.
+ */
+int concurrent_add_value(concurrent_table *ct, char *key, size_t len,
+                         int delta);
+
+/* Number of keys in the table. */
+unsigned long concurrent_count(concurrent_table *ct);
+
+/*
+ * Call 'visit' on every key/value pair.  Meant for when the updates
+ * are over: a concurrent walk may miss keys added during it.
+ */
+void foreach_concurrent_entry(concurrent_table *ct, entry_visitor visit,
+                              void *arg);
+
+#endif  /* CONCURRENT_TABLE_H */
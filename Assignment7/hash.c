@@ -0,0 +1,127 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: hash.c
+ *
+ *       The string hash shared by the hash table implementations.
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include "hash_table.h"
+
+/*** Hash function. ***/
+
+/*
+ * Multipliers and shifts for the hash, for 64-bit and for 32-bit
+ * 'unsigned long' (the xxHash primes and the MurmurHash3 finalizers).
+ */
+#if ULONG_MAX > 0xffffffffUL
+#define HASH_P1   0x9e3779b185ebca87UL
+#define HASH_P2   0xc2b2ae3d27d4eb4fUL
+#define HASH_ROT  31
+#define FMIX_M1   0xff51afd7ed558ccdUL
+#define FMIX_M2   0xc4ceb9fe1a85ec53UL
+#define FMIX_S1   33
+#define FMIX_S2   33
+#define FMIX_S3   33
+#else
+#define HASH_P1   0x9e3779b1UL
+#define HASH_P2   0x85ebca77UL
+#define HASH_ROT  13
+#define FMIX_M1   0x85ebca6bUL
+#define FMIX_M2   0xc2b2ae35UL
+#define FMIX_S1   16
+#define FMIX_S2   13
+#define FMIX_S3   16
+#endif
+
+#define WORD_BITS (sizeof(unsigned long) * CHAR_BIT)
+#define ROTL(x, r) (((x) << (r)) | ((x) >> (WORD_BITS - (r))))
+
+#ifndef ADDITIVE_HASH
+
+/*
+ * Hash a string one 'unsigned long' (8 bytes on 64-bit machines) at a
+ * time: each word is multiplied into the state xxHash-style, and the
+ * result goes through the MurmurHash3 finalizer so that every key bit
+ * reaches the low bits the slot index is taken from.  The seed is
+ * mixed in first, so the slot a key lands in can't be predicted
+ * without it.
+ */
+unsigned long hash_n(char *s, size_t len, unsigned long seed)
+{
+    unsigned long h, w;
+    h = seed ^ (len * HASH_P1);
+    while (len >= sizeof(w))
+    {
+        memcpy(&w, s, sizeof(w));
+        h ^= w * HASH_P2;
+        h = ROTL(h, HASH_ROT) * HASH_P1;
+        s += sizeof(w);
+        len -= sizeof(w);
+    }
+    if (len > 0)
+    {
+        w = 0;
+        memcpy(&w, s, len);
+        h ^= w * HASH_P2;
+        h = ROTL(h, HASH_ROT) * HASH_P1;
+    }
+    h ^= h >> FMIX_S1;
+    h *= FMIX_M1;
+    h ^= h >> FMIX_S2;
+    h *= FMIX_M2;
+    h ^= h >> FMIX_S3;
+    return h;
+}
+
+#else
+
+/* The original hash, the sum of the characters (for benchmarking). */
+unsigned long hash_n(char *s, size_t len, unsigned long seed)
+{
+    size_t i;
+    unsigned long sum;
+    sum = 0;
+    for (i = 0; i < len; i++)
+    {
+        sum += (unsigned char) s[i];
+    }
+    return sum;
+}
+
+#endif  /* ADDITIVE_HASH */
+
+
+unsigned long hash(char *s, unsigned long seed)
+{
+    return hash_n(s, strlen(s), seed);
+}
+
+
+/*
+ * Pick a seed for a new table from /dev/urandom, falling back on the
+ * clock and a stack address if that isn't available.
+ */
+unsigned long hash_seed(void)
+{
+    FILE *fp;
+    unsigned long seed;
+    seed = 0;
+    fp = fopen("/dev/urandom", "rb");
+    if (fp != NULL)
+    {
+        if (fread(&seed, sizeof(seed), 1, fp) != 1) seed = 0;
+        fclose(fp);
+    }
+    if (seed == 0)
+    {
+        seed = (unsigned long) time(NULL) ^ (unsigned long) &seed
+               ^ (unsigned long) clock();
+    }
+    return seed;
+}
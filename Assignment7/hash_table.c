@@ -19,88 +19,235 @@
 #include "memcheck.h"
 
 void memoryFail(void);
-void print_linked_list(node *list);
 
-/*** Hash function. ***/
-
-int hash(char *s)
-{
-    char c;
-    int i, sum;
-    c = s[0];
-    sum = 0;
-    for (i = 1; c != '\0'; i++)
-    {
-        sum += (int) c;
-        c = s[i];
-    }
-    return sum % 128;
-}
+static node **create_slots(unsigned long nslots);
+static node **find_chain(hash_table *ht, unsigned long h);
+static void start_resize(hash_table *ht);
+static void migrate_slots(hash_table *ht, unsigned long nmigrate);
+static void set_node_key(arena *a, node *n, char *key, size_t len);
+static node *new_node(hash_table *ht, char *key, size_t len);
+static node *find_in_chain(hash_table *ht, node *n, char *key, size_t len,
+                           unsigned long h);
+static void visit_nodes(hash_table *ht, entry_visitor visit, void *arg,
+                        int live);
+static void reuse_keys(hash_table *ht);
+static void copy_long_keys(hash_table *ht, node **slot,
+                           unsigned long first, unsigned long last);
+static void use_expiry(hash_table *ht);
+static int is_expired(hash_table *ht, char *key);
+static void clear_expiry(hash_table *ht, char *key);
+static void print_entry(char *key, int value, unsigned long hash,
+                        void *arg);
+static void index_key(char *key, int value, unsigned long hash, void *arg);
+static void filter_key(char *key, int value, unsigned long hash, void *arg);
+static void chain_stats(node **slot, unsigned long first,
+                        unsigned long last, table_stats *s);
+static void rebuild_filter(hash_table *ht, unsigned long capacity);
 
+HASH_TABLE_FUNCTIONS(exp, expiry_table, expiry_entry, unsigned long,
+                     ULONG_HASH, ULONG_EQUAL, ULONG_STORE)
 
 /*** Linked list utilities. ***/
 
-/* Create a single node. */
-node *create_node(char *key, int value)
+/* Create a single node in an arena. */
+node *create_node(arena *a, char *key, size_t len, int value)
 {
     node *n;
-    n = (node *) malloc(sizeof(node));
-    if (n == NULL) memoryFail();
-    n->key = key;
+    n = (node *) arena_alloc(a, sizeof(node));
+    set_node_key(a, n, key, len);
     n->value = value;
     n->next = NULL;
     return n;
 }
 
 
-/* Free all the nodes of a linked list. */
-void free_list(node *list)
+/* Copy a key into a node, or into the arena if it's too long. */
+static void set_node_key(arena *a, node *n, char *key, size_t len)
 {
-    node *n, *next_node;
-    n = list;
-    while (n != NULL)
+    n->len = (unsigned int) len;
+    if (len < INLINE_KEY)
     {
-        next_node = n->next;
-        free(n->key);
-        free(n);
-        n = next_node;
+        memcpy(n->key.inline_key, key, len);
+        n->key.inline_key[len] = '\0';
+    }
+    else if (ARENA_REUSING(a))
+    {
+        n->key.ptr = arena_strdup_reusable(a, key, len);
+    }
+    else
+    {
+        n->key.ptr = arena_strdup(a, key, len);
     }
 }
 
 
+/* A node for a new key: a removed one if there is one. */
+static node *new_node(hash_table *ht, char *key, size_t len)
+{
+    node *n;
+    if (ht->spare == NULL)
+    {
+        return create_node(&ht->mem, key, len, 0);
+    }
+    n = ht->spare;
+    ht->spare = n->next;
+    set_node_key(&ht->mem, n, key, len);
+    n->value = 0;
+    n->next = NULL;
+    return n;
+}
+
+
 /*** Hash table utilities. ***/
 
+/*
+ * Allocate an array of empty slots.  calloc hands back zeroed pages
+ * for big arrays without touching them, so growing the table doesn't
+ * stall on clearing the new array.
+ */
+static node **create_slots(unsigned long nslots)
+{
+    node **slot;
+    slot = (node **) calloc(nslots, sizeof(node *));
+    if (slot == NULL) memoryFail();
+    return slot;
+}
+
+
 /* Create a new hash table. */
 hash_table *create_hash_table()
+{
+    return create_hash_table_seeded(hash_seed());
+}
+
+
+hash_table *create_hash_table_seeded(unsigned long seed)
 {
     hash_table *ht;
-    int i;
     ht = (hash_table *) malloc(sizeof(hash_table));
     if (ht == NULL) memoryFail();
-    ht->slot = malloc(NSLOTS * sizeof(node *));
-    if (ht->slot == NULL) memoryFail();
-    for (i = 0; i < NSLOTS; i++)
-    {
-        ht->slot[i] = NULL;
-    }
+    ht->seed = seed;
+    ht->slot = create_slots(NSLOTS);
+    ht->nslots = NSLOTS;
+    ht->old_slot = NULL;
+    ht->old_nslots = 0;
+    ht->migrated = 0;
+    ht->count = 0;
+    arena_init(&ht->mem);
+    ht->spare = NULL;
+    ht->order = NULL;
+    ht->filter = NULL;
+    ht->expiry = NULL;
+    HT_RESET_COUNTERS(ht);
     return ht;
 }
 
 
-/* Free a hash table. */
+/*
+ * Free a hash table.  The nodes and keys all live in the arena, so
+ * there are no lists to walk.
+ */
 void free_hash_table(hash_table *ht)
 {
-    int i;
-    for(i = 0; i < NSLOTS; i++)
+    free(ht->slot);
+    if (ht->old_slot != NULL)
     {
-        /* printf("freeing hash %d\n", i); */
-        free_list(ht->slot[i]);
+        free(ht->old_slot);
     }
-    free(ht->slot);
+    if (ht->order != NULL)
+    {
+        btree_free(ht->order);
+        free(ht->order);
+    }
+    if (ht->filter != NULL)
+    {
+        bloom_free(ht->filter);
+        free(ht->filter);
+    }
+    if (ht->expiry != NULL)
+    {
+        exp_destroy(&ht->expiry->times);
+        free(ht->expiry);
+    }
+    arena_free(&ht->mem);
     free(ht);
 }
 
 
+/*
+ * Return the chain a key with hash 'h' lives in: its slot in the old
+ * array if that slot hasn't been migrated yet, else its slot in the
+ * current one.
+ */
+static node **find_chain(hash_table *ht, unsigned long h)
+{
+    unsigned long i;
+    if (ht->old_slot != NULL)
+    {
+        i = h & (ht->old_nslots - 1);
+        if (i >= ht->migrated)
+        {
+            return &ht->old_slot[i];
+        }
+    }
+    return &ht->slot[h & (ht->nslots - 1)];
+}
+
+
+/*
+ * Start growing the table: the current slots become the old slots,
+ * to be moved over a few at a time by 'migrate_slots'.
+ */
+static void start_resize(hash_table *ht)
+{
+    /* finish off a previous resize first (only if it's lagging badly) */
+    if (ht->old_slot != NULL)
+    {
+        migrate_slots(ht, ht->old_nslots);
+    }
+    ht->old_slot = ht->slot;
+    ht->old_nslots = ht->nslots;
+    ht->migrated = 0;
+    ht->nslots *= 2;
+    ht->slot = create_slots(ht->nslots);
+    HT_COUNT(ht, resizes, 1);
+    if (ht->filter != NULL && ht->count > ht->filter->capacity)
+    {
+        rebuild_filter(ht, MAX_LOAD * ht->nslots);
+    }
+}
+
+
+/*
+ * Move up to 'nmigrate' chains from the old slot array to the new
+ * one.  Nodes are relinked, not copied, and keep their cached hash.
+ */
+static void migrate_slots(hash_table *ht, unsigned long nmigrate)
+{
+    node *n, *next, **chain;
+    while (nmigrate > 0 && ht->migrated < ht->old_nslots)
+    {
+        for (n = ht->old_slot[ht->migrated]; n != NULL; n = next)
+        {
+            next = n->next;
+            chain = &ht->slot[n->hash & (ht->nslots - 1)];
+            n->next = *chain;
+            *chain = n;
+        }
+        ht->old_slot[ht->migrated] = NULL;
+        ht->migrated++;
+        nmigrate--;
+    }
+    if (ht->migrated == ht->old_nslots)
+    {
+        free(ht->old_slot);
+        ht->old_slot = NULL;
+        ht->old_nslots = 0;
+        ht->migrated = 0;
+    }
+}
+
+
 /*
  * Look for a key in the hash table.  Return 0 if not found.
  * If it is found return the associated value.
@@ -108,17 +255,211 @@ void free_hash_table(hash_table *ht)
 int get_value(hash_table *ht, char *key)
 {
     node *n;
-    n = ht->slot[hash(key)];
+    unsigned long h;
+    size_t len;
+    len = strlen(key);
+    h = hash_n(key, len, ht->seed);
+    HT_COUNT(ht, lookups, 1);
+    if (ht->filter != NULL && !bloom_maybe_contains(ht->filter, h))
+    {
+        return 0;
+    }
+    n = find_in_chain(ht, *find_chain(ht, h), key, len, h);
+    if (n == NULL)
+    {
+        /* if the value is not found */
+        if (ht->filter != NULL)
+        {
+            ht->filter->false_positives++;
+        }
+        return 0;
+    }
+    if (is_expired(ht, NODE_KEY(n)))
+    {
+        remove_key(ht, NODE_KEY(n));
+        return 0;
+    }
+    return n->value;
+}
+
+
+/*
+ * The lookups are done in three passes over each batch: hash the keys
+ * and prefetch their slots, read the slots and prefetch the first node
+ * of each chain, then walk the chains.  By the time a pass gets to a
+ * key, what it reads has had the rest of the batch's time to arrive.
+ * Expired keys are left for later: removing one could unlink a node a
+ * later key of the batch is about to look at.
+ */
+void get_values_batch(hash_table *ht, char **keys, int n, int *values)
+{
+    unsigned long h[LOOKUP_BATCH];
+    size_t len[LOOKUP_BATCH];
+    node **chain[LOOKUP_BATCH];
+    node *first[LOOKUP_BATCH], *found;
+    int i, j, m;
+
+    for (i = 0; i < n; i += m)
+    {
+        m = n - i < LOOKUP_BATCH ? n - i : LOOKUP_BATCH;
+
+        for (j = 0; j < m; j++)
+        {
+            len[j] = strlen(keys[i + j]);
+            h[j] = hash_n(keys[i + j], len[j], ht->seed);
+            HT_COUNT(ht, lookups, 1);
+            if (ht->filter != NULL &&
+                !bloom_maybe_contains(ht->filter, h[j]))
+            {
+                chain[j] = NULL;
+                continue;
+            }
+            chain[j] = find_chain(ht, h[j]);
+            HT_PREFETCH(chain[j]);
+        }
+
+        for (j = 0; j < m; j++)
+        {
+            first[j] = chain[j] == NULL ? NULL : *chain[j];
+            if (first[j] != NULL)
+            {
+                HT_PREFETCH(first[j]);
+            }
+        }
+
+        for (j = 0; j < m; j++)
+        {
+            found = chain[j] == NULL ? NULL
+                    : find_in_chain(ht, first[j], keys[i + j], len[j], h[j]);
+            if (chain[j] != NULL && found == NULL && ht->filter != NULL)
+            {
+                ht->filter->false_positives++;
+            }
+            values[i + j] = found == NULL || is_expired(ht, NODE_KEY(found))
+                            ? 0 : found->value;
+        }
+    }
+}
+
+
+/*
+ * Walk the chain starting at 'n' for 'key', of length 'len' and with
+ * hash 'h', returning its node or NULL.
+ */
+static node *find_in_chain(hash_table *ht, node *n, char *key, size_t len,
+                           unsigned long h)
+{
     while (n != NULL)
     {
-        if (strcmp(n->key, key) == 0)
+        HT_COUNT(ht, compares, 1);
+        if (n->hash == h && n->len == len
+            && memcmp(NODE_KEY(n), key, len) == 0)
         {
-            return n->value;
+            return n;
         }
         n = n->next;
     }
-    /* if the value is not found */
-    return 0;
+    return NULL;
+}
+
+
+/*
+ * Find the value stored at the 'len' bytes at 'key', adding a copy of
+ * the key with the value 0 if it isn't there, and return a pointer to
+ * it.  The key is hashed once and its chain walked once, or not at all
+ * if the Bloom filter knows it's new.
+ */
+int *find_or_insert_n(hash_table *ht, char *key, size_t len)
+{
+    node *n, **chain;
+    unsigned long h;
+    /* each change to the table carries a growing table along a bit */
+    if (ht->old_slot != NULL)
+    {
+        migrate_slots(ht, MIGRATE_SLOTS);
+    }
+    /* ... and looks for some keys that have expired */
+    if (ht->expiry != NULL)
+    {
+        expire_keys(ht, EXPIRE_SLOTS);
+    }
+    h = hash_n(key, len, ht->seed);
+    chain = find_chain(ht, h);
+    HT_COUNT(ht, lookups, 1);
+    if (ht->filter == NULL || bloom_maybe_contains(ht->filter, h))
+    {
+        n = find_in_chain(ht, *chain, key, len, h);
+        if (n != NULL)
+        {
+            if (is_expired(ht, NODE_KEY(n)))
+            {
+                /* an expired key starts over */
+                clear_expiry(ht, NODE_KEY(n));
+                n->value = 0;
+            }
+            return &n->value;
+        }
+        if (ht->filter != NULL)
+        {
+            ht->filter->false_positives++;
+        }
+    }
+    /* if the key isn't there, add it at the front of its chain */
+    n = new_node(ht, key, len);
+    n->hash = h;
+    n->next = *chain;
+    *chain = n;
+    ht->count++;
+    HT_COUNT(ht, inserts, 1);
+    if (ht->order != NULL)
+    {
+        btree_insert(ht->order, NODE_KEY(n));
+    }
+    if (ht->filter != NULL)
+    {
+        bloom_add(ht->filter, h);
+    }
+    /* (starting a resize doesn't move any nodes) */
+    if (ht->count > MAX_LOAD * ht->nslots)
+    {
+        start_resize(ht);
+    }
+    return &n->value;
+}
+
+
+int *find_or_insert_copy(hash_table *ht, char *key)
+{
+    return find_or_insert_n(ht, key, strlen(key));
+}
+
+
+/* As find_or_insert_copy, but the table takes ownership of 'key'. */
+int *find_or_insert(hash_table *ht, char *key)
+{
+    int *value;
+    value = find_or_insert_copy(ht, key);
+    free(key);
+    return value;
+}
+
+
+/* Add 1 to the value stored at a key and return the new value. */
+int increment_value_copy(hash_table *ht, char *key)
+{
+    return ++*find_or_insert_copy(ht, key);
+}
+
+
+int increment_value_n(hash_table *ht, char *key, size_t len)
+{
+    return ++*find_or_insert_n(ht, key, len);
+}
+
+
+int increment_value(hash_table *ht, char *key)
+{
+    return ++*find_or_insert(ht, key);
 }
 
 
@@ -129,49 +470,434 @@ int get_value(hash_table *ht, char *key)
  */
 void set_value(hash_table *ht, char *key, int value)
 {
+    *find_or_insert(ht, key) = value;
+}
+
+
+/* Print out the contents of the hash table as key/value pairs. */
+void print_hash_table(hash_table *ht)
+{
+    foreach_entry(ht, print_entry, NULL);
+}
+
+
+/* Print one key/value pair (expired keys never get here). */
+static void print_entry(char *key, int value, unsigned long hash,
+                        void *arg)
+{
+    printf("%s %d\n", key, value);
+}
+
+/* Call 'visit' on every key/value pair in the table. */
+void foreach_entry(hash_table *ht, entry_visitor visit, void *arg)
+{
+    visit_nodes(ht, visit, arg, 1);
+}
+
+
+/*
+ * Visit every node, or if 'live' is set only those that haven't
+ * expired.  The filter and the index are built from all of them, as
+ * expired keys are still in the table until they are removed.
+ */
+static void visit_nodes(hash_table *ht, entry_visitor visit, void *arg,
+                        int live)
+{
+    unsigned long i;
     node *n;
-    n = ht->slot[hash(key)];
-    while (n != NULL)
+    for (i = 0; i < ht->nslots; i++)
     {
-        if (strcmp(n->key, key) == 0)
+        for (n = ht->slot[i]; n != NULL; n = n->next)
         {
-            n->value = value;
-            free(key);
-            return;
+            if (!live || !is_expired(ht, NODE_KEY(n)))
+            {
+                visit(NODE_KEY(n), n->value, n->hash, arg);
+            }
         }
-        if (n->next == NULL)
+    }
+    if (ht->old_slot != NULL)
+    {
+        for (i = ht->migrated; i < ht->old_nslots; i++)
         {
-            n->next = create_node(key, value);
-            return;
+            for (n = ht->old_slot[i]; n != NULL; n = n->next)
+            {
+                if (!live || !is_expired(ht, NODE_KEY(n)))
+                {
+                    visit(NODE_KEY(n), n->value, n->hash, arg);
+                }
+            }
         }
-        n = n->next;
     }
-    /* if no value is present at the hash */
-    ht->slot[hash(key)] = create_node(key, value);
 }
 
 
-/* Print out the contents of the hash table as key/value pairs. */
-void print_hash_table(hash_table *ht)
+/*** Removal and expiry. ***/
+
+/*
+ * Long keys are packed tightly until the first key is removed or
+ * given an expiry time.  From then on they are stored in blocks that
+ * can be handed back, and the long keys already here are copied into
+ * such blocks (their packed copies stay where they are, so a stored
+ * key passed in still reads the same).  The index points at the keys,
+ * so it is built again; no key has an expiry time yet.
+ */
+static void reuse_keys(hash_table *ht)
 {
-    int i;
-    for (i = 0; i < NSLOTS; i++)
+    if (ARENA_REUSING(&ht->mem))
+    {
+        return;
+    }
+    arena_start_reuse(&ht->mem);
+    copy_long_keys(ht, ht->slot, 0, ht->nslots);
+    if (ht->old_slot != NULL)
+    {
+        copy_long_keys(ht, ht->old_slot, ht->migrated, ht->old_nslots);
+    }
+    if (ht->order != NULL)
     {
-        print_linked_list(ht->slot[i]);
+        btree_free(ht->order);
+        free(ht->order);
+        ht->order = NULL;
+        add_ordered_index(ht);
     }
 }
 
-void print_linked_list(node *list)
+
+/* Copy the long keys of slots 'first' to 'last' - 1 again. */
+static void copy_long_keys(hash_table *ht, node **slot,
+                           unsigned long first, unsigned long last)
 {
+    unsigned long i;
     node *n;
-    n = list;
-    while (n != NULL)
+    for (i = first; i < last; i++)
     {
-        printf("%s %d\n", n->key, n->value);
-        n = n->next;
+        for (n = slot[i]; n != NULL; n = n->next)
+        {
+            if (n->len >= INLINE_KEY)
+            {
+                n->key.ptr = arena_strdup_reusable(&ht->mem, n->key.ptr,
+                                                   n->len);
+            }
+        }
+    }
+}
+
+
+int remove_key(hash_table *ht, char *key)
+{
+    node *n, **link;
+    unsigned long h;
+    size_t len;
+    int live;
+
+    reuse_keys(ht);
+    len = strlen(key);
+    h = hash_n(key, len, ht->seed);
+    for (link = find_chain(ht, h); *link != NULL; link = &(*link)->next)
+    {
+        n = *link;
+        if (n->hash == h && n->len == len
+            && memcmp(NODE_KEY(n), key, len) == 0)
+        {
+            break;
+        }
+    }
+    if (*link == NULL)
+    {
+        return 0;
+    }
+
+    live = !is_expired(ht, NODE_KEY(n));
+    *link = n->next;
+    ht->count--;
+    if (ht->order != NULL)
+    {
+        btree_remove(ht->order, NODE_KEY(n));
+    }
+    clear_expiry(ht, NODE_KEY(n));
+    if (ht->filter != NULL
+        && ++ht->filter->removed > ht->filter->capacity / 4)
+    {
+        rebuild_filter(ht, ht->filter->capacity);
+    }
+
+    /* the node is reused by the next insert, a long key's copy by the
+       next long key of about its length */
+    if (n->len >= INLINE_KEY)
+    {
+        arena_release(&ht->mem, n->key.ptr, n->len + 1);
+    }
+    n->next = ht->spare;
+    ht->spare = n;
+    return live;
+}
+
+
+/* Give the table expiry times, if it hasn't any yet. */
+static void use_expiry(hash_table *ht)
+{
+    if (ht->expiry != NULL)
+    {
+        return;
+    }
+    ht->expiry = (key_expiry *) malloc(sizeof(key_expiry));
+    if (ht->expiry == NULL) memoryFail();
+    exp_init(&ht->expiry->times, hash_seed());
+    ht->expiry->now = 0;
+    ht->expiry->cursor = 0;
+}
+
+
+/* Has the stored key 'key' expired? */
+static int is_expired(hash_table *ht, char *key)
+{
+    expiry_entry *e;
+    if (ht->expiry == NULL || ht->expiry->times.count == 0)
+    {
+        return 0;
+    }
+    e = exp_find(&ht->expiry->times, (unsigned long) key);
+    return e != NULL && e->value <= ht->expiry->now;
+}
+
+
+/* Forget the expiry time of the stored key 'key', if it has one. */
+static void clear_expiry(hash_table *ht, char *key)
+{
+    expiry_entry *e;
+    if (ht->expiry == NULL || ht->expiry->times.count == 0)
+    {
+        return;
+    }
+    e = exp_find(&ht->expiry->times, (unsigned long) key);
+    if (e != NULL)
+    {
+        exp_remove(&ht->expiry->times, e);
+    }
+}
+
+
+int set_expiry(hash_table *ht, char *key, unsigned long when)
+{
+    node *n;
+    unsigned long h;
+    size_t len;
+
+    reuse_keys(ht);
+    len = strlen(key);
+    h = hash_n(key, len, ht->seed);
+    n = find_in_chain(ht, *find_chain(ht, h), key, len, h);
+    if (n == NULL)
+    {
+        return 0;
+    }
+    if (is_expired(ht, NODE_KEY(n)))
+    {
+        remove_key(ht, NODE_KEY(n));
+        return 0;
+    }
+
+    if (when == 0)
+    {
+        clear_expiry(ht, NODE_KEY(n));
+    }
+    else
+    {
+        use_expiry(ht);
+        exp_find_or_insert(&ht->expiry->times,
+                           (unsigned long) NODE_KEY(n))->value = when;
+    }
+    return 1;
+}
+
+
+void set_clock(hash_table *ht, unsigned long now)
+{
+    use_expiry(ht);
+    ht->expiry->now = now;
+}
+
+
+/*
+ * Walk the expiry times from where the last call left off.  Removing
+ * a key moves the next entry back into the slot just checked, so the
+ * walk only moves on past slots it leaves alone.
+ */
+unsigned long expire_keys(hash_table *ht, unsigned long nslots)
+{
+    expiry_table *times;
+    expiry_entry *e;
+    unsigned long removed;
+
+    if (ht->expiry == NULL)
+    {
+        return 0;
+    }
+    times = &ht->expiry->times;
+    removed = 0;
+
+    for ( ; nslots > 0 && times->count > 0; nslots--)
+    {
+        e = &times->entry[ht->expiry->cursor & (times->nslots - 1)];
+        if (e->hash != 0 && e->value <= ht->expiry->now)
+        {
+            remove_key(ht, (char *) e->key);
+            removed++;
+        }
+        else
+        {
+            ht->expiry->cursor++;
+        }
+    }
+    return removed;
+}
+
+/*** Statistics. ***/
+
+/* Add the chains of slots [first, last) of 'slot' to the stats. */
+static void chain_stats(node **slot, unsigned long first,
+                        unsigned long last, table_stats *s)
+{
+    unsigned long i, len;
+    node *n;
+    for (i = first; i < last; i++)
+    {
+        len = 0;
+        for (n = slot[i]; n != NULL; n = n->next)
+        {
+            len++;
+        }
+        s->hist[len < STATS_HIST ? len : STATS_HIST]++;
+        if (len > s->longest)
+        {
+            s->longest = len;
+        }
+        /* finding each key of the chain once takes 1 + 2 + ... + len */
+        s->compares += len * (len + 1) / 2.0;
+    }
+}
+
+
+void hash_table_stats(hash_table *ht, table_stats *s)
+{
+    memset(s, 0, sizeof(table_stats));
+    s->kind = "separate chaining";
+    s->hist_label = "chain length";
+    s->hist_unit = "slots";
+    s->count = ht->count;
+    s->nslots = ht->nslots + ht->old_nslots - ht->migrated;
+
+    chain_stats(ht->slot, 0, ht->nslots, s);
+    if (ht->old_slot != NULL)
+    {
+        chain_stats(ht->old_slot, ht->migrated, ht->old_nslots, s);
+    }
+
+    s->load = (double) s->count / s->nslots;
+    s->compares = s->count == 0 ? 0.0 : s->compares / s->count;
+    s->bytes = sizeof(hash_table)
+               + (ht->nslots + ht->old_nslots) * sizeof(node *)
+               + ht->mem.size;
+    if (ht->order != NULL)
+    {
+        s->bytes += sizeof(btree) + ht->order->mem.size;
+    }
+    if (ht->expiry != NULL)
+    {
+        s->bytes += sizeof(key_expiry)
+                    + ht->expiry->times.nslots * sizeof(expiry_entry);
     }
+    s->filter_fp = -1.0;
+    if (ht->filter != NULL)
+    {
+        s->bytes += sizeof(bloom_filter)
+                    + ht->filter->nblocks * BLOOM_BLOCK_BYTES;
+        s->filter_fp = bloom_false_positive_rate(ht->filter);
+    }
+#ifdef HASH_TABLE_STATS
+    s->counted = 1;
+    s->ops = ht->ops;
+#endif
+}
+
+
+/*** Bloom filter. ***/
+
+static void filter_key(char *key, int value, unsigned long hash, void *arg)
+{
+    bloom_add((bloom_filter *) arg, hash);
+}
+
+
+/* Refill the filter from the hashes in the nodes. */
+static void rebuild_filter(hash_table *ht, unsigned long capacity)
+{
+    bloom_resize(ht->filter, capacity);
+    visit_nodes(ht, filter_key, ht->filter, 0);
+}
+
+
+void add_bloom_filter(hash_table *ht, unsigned long expected)
+{
+    if (ht->filter != NULL)
+    {
+        return;
+    }
+    ht->filter = (bloom_filter *) malloc(sizeof(bloom_filter));
+    if (ht->filter == NULL) memoryFail();
+    bloom_init(ht->filter, expected > ht->count ? expected : ht->count);
+    visit_nodes(ht, filter_key, ht->filter, 0);
+}
+
+
+/*** Ordered index. ***/
+
+static void index_key(char *key, int value, unsigned long hash, void *arg)
+{
+    btree_insert((btree *) arg, key);
+}
+
+
+void add_ordered_index(hash_table *ht)
+{
+    if (ht->order != NULL)
+    {
+        return;
+    }
+    ht->order = (btree *) malloc(sizeof(btree));
+    if (ht->order == NULL) memoryFail();
+    btree_init(ht->order);
+    visit_nodes(ht, index_key, ht->order, 0);
+}
+
+
+void find_range(hash_table *ht, char *lo, char *hi, key_range *r)
+{
+    add_ordered_index(ht);
+    r->ht = ht;
+    r->hi = hi;
+    btree_seek(ht->order, &r->cursor, lo);
+}
+
+
+int next_in_range(key_range *r, char **key, int *value)
+{
+    char *k;
+    do
+    {
+        k = btree_next(&r->cursor);
+        if (k == NULL || (r->hi != NULL && strcmp(k, r->hi) >= 0))
+        {
+            r->cursor.depth = 0;
+            return 0;
+        }
+    } while (is_expired(r->ht, k));
+    *key = k;
+    *value = get_value(r->ht, k);
+    return 1;
 }
 
+
 void memoryFail(void)
 {
     printf("Failed to allocate memory; exiting\n");
@@ -15,34 +15,141 @@
 #ifndef HASH_TABLE_H
 #define HASH_TABLE_H
 
-/* Number of slots in the hash table array. */
+#include "arena.h"
+#include "hash_template.h"
+#include "btree.h"
+#include "bloom.h"
+
+/* Initial number of slots in the hash table array (a power of two). */
 #define NSLOTS 128
 
+/*
+ * The chained table grows (doubles) when it holds more than MAX_LOAD
+ * keys per slot on average.  Growing is incremental: the old slot
+ * array is kept around and every update of the table moves
+ * MIGRATE_SLOTS of its chains over to the new one, so no single call
+ * pays for a full rehash.
+ */
+#define MAX_LOAD      1
+#define MIGRATE_SLOTS 2
+
+/* get_values_batch works through its keys LOOKUP_BATCH at a time. */
+#define LOOKUP_BATCH 16
+
+/*
+ * In a table whose keys can expire, every update also checks
+ * EXPIRE_SLOTS slots of the expiry times for keys past their time, as
+ * it moves chains along while growing.  The expiry times have up to
+ * 2.5 slots per key (see HT_MAX_LOAD), so this must be well over 2.5:
+ * otherwise a table getting a new key every update sweeps its times
+ * more slowly than they come due, and the expired keys pile up.
+ */
+#define EXPIRE_SLOTS 8
+
+/*
+ * Expiry times of keys are kept apart from the table, so that tables
+ * without them pay nothing: an integer table from hash_template.h
+ * maps the address of a stored key (which never moves) to the time
+ * it expires.
+ */
+
+HASH_TABLE_TYPES(expiry_table, expiry_entry, unsigned long, unsigned long);
+
+typedef struct
+{
+    expiry_table times;         /* key address -> expiry time        */
+    unsigned long now;          /* the table's clock                 */
+    unsigned long cursor;       /* next slot of 'times' to check     */
+} key_expiry;
+
 /*
  * Data structure definitions.
+ *
+ * There are two implementations of the table behind the same
+ * functions: separate chaining (hash_table.c, the default) and open
+ * addressing (hash_table_oa.c, built with -DOPEN_ADDRESSING).
  */
 
+#ifndef OPEN_ADDRESSING
+
 /*
  * Declaration of the linked list `node' struct.
+ *
+ * Keys shorter than INLINE_KEY bytes (most words) are stored in the
+ * node itself, so finding one reads a single piece of memory and
+ * costs no separate allocation; longer keys are copied to the table's
+ * arena and pointed to.  NODE_KEY gives the key either way.  Nodes
+ * never move, so the key pointers handed out stay good.  Keys are
+ * compared by hash, then length, and only then by their bytes.
  */
 
+#define INLINE_KEY 16
+
 typedef struct _node
 {
-    char *key;
-    int value;
+    unsigned long hash; /* hash(key), kept so resizing needn't rehash */
     struct _node *next; /* pointer to the next node in the list */
+    unsigned int len;   /* strlen(key) */
+    int value;
+    union
+    {
+        char inline_key[INLINE_KEY];    /* if len < INLINE_KEY */
+        char *ptr;                      /* otherwise           */
+    } key;
 } node;
 
+#define NODE_KEY(n) \
+    ((n)->len < INLINE_KEY ? (n)->key.inline_key : (n)->key.ptr)
+
 /*
  * Declaration of the hash table struct.
  * 'slot' is an array of node pointers, so it's a pointer to a pointer.
+ *
+ * While the table is growing, 'old_slot' holds the previous slot
+ * array.  Its chains at indices below 'migrated' have already been
+ * moved to 'slot'; the rest are still searched in place.
  */
 
 typedef struct
 {
     node **slot;
+    unsigned long nslots;       /* size of 'slot', a power of two    */
+    node **old_slot;            /* slots being migrated, or NULL     */
+    unsigned long old_nslots;   /* size of 'old_slot'                */
+    unsigned long migrated;     /* old slots already moved           */
+    unsigned long count;        /* number of keys in the table       */
+    unsigned long seed;         /* random seed for 'hash'            */
+    arena mem;                  /* the nodes and their keys          */
+    node *spare;                /* removed nodes, for reuse          */
+    btree *order;               /* ordered index of keys, or NULL    */
+    bloom_filter *filter;       /* filter for misses, or NULL        */
+    key_expiry *expiry;         /* expiry times of keys, or NULL     */
+    HT_COUNTERS                 /* with -DHASH_TABLE_STATS           */
+} hash_table;
+
+#else  /* OPEN_ADDRESSING */
+
+/*
+ * The open addressing table is the string -> int instance of the
+ * tables in hash_template.h: a flat array of entries with linear
+ * probing and Robin Hood insertion, growing at HT_MAX_LOAD percent
+ * full.  The hash and value are stored inline, so a probe reads the
+ * key string only when the hashes match.  'key' is NULL in an empty
+ * entry.
+ */
+
+HASH_TABLE_TYPES(oa_table, entry, char *, int);
+
+typedef struct
+{
+    oa_table table;             /* the keys and values               */
+    btree *order;               /* ordered index of keys, or NULL    */
+    bloom_filter *filter;       /* filter for misses, or NULL        */
+    key_expiry *expiry;         /* expiry times of keys, or NULL     */
 } hash_table;
 
+#endif  /* OPEN_ADDRESSING */
+
 
 /*
  * Function declarations.
@@ -50,22 +157,45 @@ typedef struct
 
 /*** Hash function. ***/
 
-int hash(char *s);
+/*
+ * Hash a string.  Each table draws its own random 'seed', so inputs
+ * crafted to collide in one run don't collide in the next.  The slot
+ * index is taken from the low bits of the hash.
+ */
+unsigned long hash(char *s, unsigned long seed);
+
+/* Hash the 'len' bytes at 's', which needn't be zero-terminated. */
+unsigned long hash_n(char *s, size_t len, unsigned long seed);
+
+/* A fresh random seed for a new table. */
+unsigned long hash_seed(void);
+
 
+#ifndef OPEN_ADDRESSING
 
 /*** Linked list utilities. ***/
 
-/* Create a single node whose 'next' field is NULL. */
-node *create_node(char *key, int value);
+/*
+ * Create a single node whose 'next' field is NULL, with a copy of the
+ * 'len' bytes at 'key' as its key.  Nodes and long keys are carved out
+ * of an arena and freed along with it.
+ */
+node *create_node(arena *a, char *key, size_t len, int value);
 
-/* Free all the nodes of a linked list. */
-void free_list(node *list);
+#endif  /* OPEN_ADDRESSING */
 
 
 /*** Hash table utilities. ***/
 
 hash_table *create_hash_table(void);
 
+/*
+ * Create a table with a given hash seed.  Tables with the same seed
+ * hash every key the same way, which lets their contents be
+ * partitioned by hash and merged.
+ */
+hash_table *create_hash_table_seeded(unsigned long seed);
+
 void free_hash_table(hash_table *ht);
 
 /*
@@ -74,6 +204,15 @@ void free_hash_table(hash_table *ht);
  */
 int get_value(hash_table *ht, char *key);
 
+/*
+ * Look up 'n' keys at once, storing the value of keys[i] (0 if it
+ * isn't there) in values[i].  The same as calling get_value on each,
+ * but faster for a table much bigger than the cache: the keys of a
+ * batch are all hashed and their slots prefetched first, so their
+ * cache misses overlap instead of being waited for one by one.
+ */
+void get_values_batch(hash_table *ht, char **keys, int n, int *values);
+
 /*
  * Set the value stored at a key.  If the key is not in the table,
  * create a new node and set the value to 'value'.  Note that this
@@ -81,9 +220,175 @@ int get_value(hash_table *ht, char *key);
  */
 void set_value(hash_table *ht, char *key, int value);
 
+/*
+ * Return a pointer to the value stored at a key, first adding the key
+ * with the value 0 if it is not in the table.  Like set_value, this
+ * takes ownership of 'key' and frees it.  The pointer is only good
+ * until the next key is added.
+ */
+int *find_or_insert(hash_table *ht, char *key);
+
+/*
+ * Add 1 to the value stored at a key (adding the key if need be) and
+ * return the new value.  Takes ownership of 'key' like set_value.
+ */
+int increment_value(hash_table *ht, char *key);
+
+/*
+ * Variants of the above that leave 'key' with the caller.  The table
+ * copies the key into its arena the first time it is added, so the
+ * caller needn't allocate a key per call.
+ */
+int *find_or_insert_copy(hash_table *ht, char *key);
+int increment_value_copy(hash_table *ht, char *key);
+
+/*
+ * The same for a key given as 'len' bytes at 'key', not zero
+ * terminated (a view into the input, say).
+ */
+int *find_or_insert_n(hash_table *ht, char *key, size_t len);
+int increment_value_n(hash_table *ht, char *key, size_t len);
+
 /* Print out the contents of the hash table as key/value pairs. */
 void print_hash_table(hash_table *ht);
 
+/*
+ * Call 'visit' on every key/value pair in the table, in no particular
+ * order, passing on 'arg'.  'hash' is the key's hash with the table's
+ * seed.  Keys past their expiry time are skipped.  The table must not
+ * be changed during the walk.
+ */
+typedef void (*entry_visitor)(char *key, int value, unsigned long hash,
+                              void *arg);
+
+void foreach_entry(hash_table *ht, entry_visitor visit, void *arg);
+
+
+/*** Removal and expiry. ***/
+
+/*
+ * Take a key out of the table (and its index, if it has one).
+ * Returns 1 if it was there, 0 if not (or if it had expired).  The
+ * chained table unlinks the node and keeps it for the next key
+ * added; the open addressing one moves the entries after it back a
+ * place.  Either way no tombstones are left behind, and a table
+ * whose keys come and go stays the same size.  Keys copied into the
+ * arena (those of INLINE_KEY bytes or more, and all keys of the open
+ * addressing table) are handed back to it with arena_release, for the
+ * next keys of their size class.  Until a table first removes a key
+ * or gives one an expiry time it packs its keys tightly instead; the
+ * keys it has then are copied once.  A Bloom filter can't forget a key,
+ * so it is rebuilt once a quarter of the keys it was sized for have
+ * been removed.
+ */
+int remove_key(hash_table *ht, char *key);
+
+/*
+ * Keys can be given a time to expire, for using the table as a cache.
+ * Times are in whatever unit the caller counts in (seconds from
+ * time(), say); the table knows the time only from set_clock.  A key
+ * whose time has come is gone as far as the table's users are
+ * concerned: get_value returns 0 for it (and removes it),
+ * find_or_insert starts it over at 0 with no expiry time, and the
+ * walks and range queries skip it.  Expired keys are also removed in
+ * the background: every update of the table checks EXPIRE_SLOTS
+ * slots of the expiry times, and expire_keys does more at a time.
+ * Tables keep no expiry times until they are first used.
+ *
+ * set_expiry makes a key in the table expire at time 'when', or never
+ * if 'when' is 0, and returns 1; it returns 0 if the key isn't there.
+ * set_clock sets the table's time; it should never go back.
+ * expire_keys checks the next 'nslots' slots of the expiry times,
+ * removes the expired keys it finds there and returns how many.
+ */
+int set_expiry(hash_table *ht, char *key, unsigned long when);
+void set_clock(hash_table *ht, unsigned long now);
+unsigned long expire_keys(hash_table *ht, unsigned long nslots);
+
+
+/*** Statistics. ***/
+
+/* Longer chains or probes are counted together in the histogram. */
+#define STATS_HIST 8
+
+/*
+ * What a table looks like, for telling collisions from resize churn
+ * from memory use.  The histogram is of chain lengths (slots with a
+ * chain of i keys) in the chained table, and of distances from the
+ * home slot (keys i entries from it) in the open addressing one.
+ * 'ops' is only filled in by a build with -DHASH_TABLE_STATS, which
+ * sets 'counted'.
+ */
+
+typedef struct
+{
+    char *kind;                 /* which table this is               */
+    unsigned long count;        /* keys                              */
+    unsigned long nslots;       /* slots (both arrays mid-resize)    */
+    double load;                /* keys per slot                     */
+    char *hist_label;           /* what the histogram is of ...      */
+    char *hist_unit;            /* ... and what it counts            */
+    unsigned long hist[STATS_HIST + 1];
+    unsigned long longest;      /* entries looked at, worst case     */
+    double compares;            /* entries looked at, per key found  */
+    size_t bytes;               /* slots, nodes or entries, keys,
+                                   index and filter                  */
+    double filter_fp;           /* false positive rate, or -1        */
+    int counted;
+    ht_counters ops;
+} table_stats;
+
+/*
+ * Fill in 's' for 'ht'.  This walks the whole table, so it is for
+ * reports, not for inner loops.
+ */
+void hash_table_stats(hash_table *ht, table_stats *s);
+
+
+/*** Bloom filter. ***/
+
+/*
+ * Put a Bloom filter in front of a table's lookups, sized for
+ * 'expected' keys (or the keys already in the table, if more).  Most
+ * lookups of missing keys are then answered without looking at the
+ * table, and a key the filter doesn't know is added without being
+ * looked for.  When the table grows past what the filter was sized
+ * for, the filter is rebuilt for the table's new size from the hashes
+ * the table keeps.  The filter's counts (ht->filter->lookups and so
+ * on, and bloom_false_positive_rate) say how well it does.
+ */
+void add_bloom_filter(hash_table *ht, unsigned long expected);
+
+
+/*** Ordered index. ***/
+
+/*
+ * Give a table an index of its keys in strcmp order (a B-tree), for
+ * range queries.  The keys already in the table are added to it, and
+ * every key added later goes in as well.  Tables have no index unless
+ * it is asked for.
+ */
+void add_ordered_index(hash_table *ht);
+
+/* A range query in progress. */
+
+typedef struct
+{
+    hash_table *ht;
+    btree_cursor cursor;
+    char *hi;                   /* end of the range, or NULL */
+} key_range;
+
+/*
+ * Start walking the keys from 'lo' up to but not including 'hi', in
+ * strcmp order.  Either can be NULL for no bound.  The table gets an
+ * ordered index if it hasn't one.  Each call of next_in_range then
+ * stores the next key and its value and returns 1, or returns 0 at
+ * the end of the range.  The table must not change during the walk.
+ */
+void find_range(hash_table *ht, char *lo, char *hi, key_range *r);
+int next_in_range(key_range *r, char **key, int *value);
+
 /* This line is part of the "include guard": */
 #endif  /* HASH_TABLE_H */
 
@@ -0,0 +1,657 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: hash_table_oa.c
+ *
+ *       Open addressing implementation of the hash table, with
+ *       Robin Hood linear probing.  Build everything that includes
+ *       hash_table.h with -DOPEN_ADDRESSING to use it.
+ *
+ *       The table itself is generated from hash_template.h, for
+ *       string keys and int values; this file puts the hash_table.h
+ *       interface on it.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hash_table.h"
+#include "memcheck.h"
+
+#ifndef OPEN_ADDRESSING
+#error "hash_table_oa.c must be compiled with -DOPEN_ADDRESSING"
+#endif
+
+void memoryFail(void);
+
+static void index_key(char *key, int value, unsigned long hash, void *arg);
+static void filter_key(char *key, int value, unsigned long hash, void *arg);
+static void rebuild_filter(hash_table *ht, unsigned long capacity);
+static entry *find_entry(hash_table *ht, str_view k, unsigned long h);
+static void visit_entries(hash_table *ht, entry_visitor visit, void *arg,
+                          int live);
+static void print_entry(char *key, int value, unsigned long hash,
+                        void *arg);
+static void reuse_keys(hash_table *ht);
+static void use_expiry(hash_table *ht);
+static int is_expired(hash_table *ht, char *key);
+static void clear_expiry(hash_table *ht, char *key);
+
+HASH_TABLE_FUNCTIONS(oa, oa_table, entry, str_view,
+                     STR_HASH, STR_EQUAL, STR_STORE_REUSABLE)
+
+HASH_TABLE_FUNCTIONS(exp, expiry_table, expiry_entry, unsigned long,
+                     ULONG_HASH, ULONG_EQUAL, ULONG_STORE)
+
+
+/*** Hash table utilities. ***/
+
+/* Create a new hash table. */
+hash_table *create_hash_table()
+{
+    return create_hash_table_seeded(hash_seed());
+}
+
+
+hash_table *create_hash_table_seeded(unsigned long seed)
+{
+    hash_table *ht;
+    ht = (hash_table *) malloc(sizeof(hash_table));
+    if (ht == NULL) memoryFail();
+    oa_init(&ht->table, seed);
+    ht->order = NULL;
+    ht->filter = NULL;
+    ht->expiry = NULL;
+    return ht;
+}
+
+
+/* Free a hash table.  The keys all live in the arena. */
+void free_hash_table(hash_table *ht)
+{
+    oa_destroy(&ht->table);
+    if (ht->order != NULL)
+    {
+        btree_free(ht->order);
+        free(ht->order);
+    }
+    if (ht->filter != NULL)
+    {
+        bloom_free(ht->filter);
+        free(ht->filter);
+    }
+    if (ht->expiry != NULL)
+    {
+        exp_destroy(&ht->expiry->times);
+        free(ht->expiry);
+    }
+    free(ht);
+}
+
+
+/*
+ * Look for a key in the hash table.  Return 0 if not found.
+ * If it is found return the associated value.
+ */
+int get_value(hash_table *ht, char *key)
+{
+    str_view k;
+    unsigned long h;
+    entry *e;
+    k.s = key;
+    k.len = strlen(key);
+    h = oa_hash(&ht->table, k);
+    if (ht->filter != NULL && !bloom_maybe_contains(ht->filter, h))
+    {
+        HT_COUNT(&ht->table, lookups, 1);
+        return 0;
+    }
+    e = find_entry(ht, k, h);
+    if (e == NULL)
+    {
+        return 0;
+    }
+    if (is_expired(ht, e->key))
+    {
+        remove_key(ht, e->key);
+        return 0;
+    }
+    return e->value;
+}
+
+
+/*
+ * Each batch is hashed and its home entries prefetched in one pass,
+ * then probed in a second, by which time the entries have arrived.
+ * A key the Bloom filter turns away gets a hash of 0, which no
+ * entry has.  Expired keys are left for later, as in the chained
+ * table.
+ */
+void get_values_batch(hash_table *ht, char **keys, int n, int *values)
+{
+    str_view k[LOOKUP_BATCH];
+    unsigned long h[LOOKUP_BATCH];
+    entry *e;
+    int i, j, m;
+
+    for (i = 0; i < n; i += m)
+    {
+        m = n - i < LOOKUP_BATCH ? n - i : LOOKUP_BATCH;
+
+        for (j = 0; j < m; j++)
+        {
+            k[j].s = keys[i + j];
+            k[j].len = strlen(keys[i + j]);
+            h[j] = oa_hash(&ht->table, k[j]);
+            if (ht->filter != NULL &&
+                !bloom_maybe_contains(ht->filter, h[j]))
+            {
+                HT_COUNT(&ht->table, lookups, 1);
+                h[j] = 0;
+                continue;
+            }
+            oa_prefetch(&ht->table, h[j]);
+        }
+
+        for (j = 0; j < m; j++)
+        {
+            e = h[j] == 0 ? NULL : find_entry(ht, k[j], h[j]);
+            values[i + j] = e == NULL || is_expired(ht, e->key)
+                            ? 0 : e->value;
+        }
+    }
+}
+
+
+/* Probe for 'k', with hash 'h', returning its entry or NULL. */
+static entry *find_entry(hash_table *ht, str_view k, unsigned long h)
+{
+    entry *e;
+    e = oa_find_hashed(&ht->table, k, h);
+    if (e == NULL && ht->filter != NULL)
+    {
+        ht->filter->false_positives++;
+    }
+    return e;
+}
+
+
+/*
+ * Find the value stored at the 'len' bytes at 'key', adding a copy of
+ * the key with the value 0 if it isn't there, and return a pointer to
+ * it.  A key the Bloom filter doesn't know is added without a probe.
+ */
+int *find_or_insert_n(hash_table *ht, char *key, size_t len)
+{
+    str_view k;
+    unsigned long h, count, nslots;
+    entry *e;
+    /* each update looks for some keys that have expired */
+    if (ht->expiry != NULL)
+    {
+        expire_keys(ht, EXPIRE_SLOTS);
+    }
+    k.s = key;
+    k.len = len;
+    h = oa_hash(&ht->table, k);
+    count = ht->table.count;
+    nslots = ht->table.nslots;
+
+    if (ht->filter == NULL)
+    {
+        e = oa_find_or_insert_hashed(&ht->table, k, h);
+    }
+    else if (!bloom_maybe_contains(ht->filter, h))
+    {
+        e = oa_insert_new(&ht->table, k, h);
+    }
+    else
+    {
+        e = oa_find_or_insert_hashed(&ht->table, k, h);
+        if (ht->table.count != count)
+        {
+            ht->filter->false_positives++;
+        }
+    }
+
+    if (ht->table.count != count)
+    {
+        if (ht->order != NULL)
+        {
+            btree_insert(ht->order, e->key);
+        }
+        if (ht->filter != NULL)
+        {
+            bloom_add(ht->filter, h);
+        }
+    }
+    else if (is_expired(ht, e->key))
+    {
+        /* an expired key starts over */
+        clear_expiry(ht, e->key);
+        e->value = 0;
+    }
+
+    /* (the table grows before it looks, so even a hit can grow it) */
+    if (ht->filter != NULL && ht->table.nslots != nslots
+        && ht->table.count > ht->filter->capacity)
+    {
+        rebuild_filter(ht, ht->table.nslots * HT_MAX_LOAD / 100);
+    }
+    return &e->value;
+}
+
+
+int *find_or_insert_copy(hash_table *ht, char *key)
+{
+    return find_or_insert_n(ht, key, strlen(key));
+}
+
+
+/* As find_or_insert_copy, but the table takes ownership of 'key'. */
+int *find_or_insert(hash_table *ht, char *key)
+{
+    int *value;
+    value = find_or_insert_copy(ht, key);
+    free(key);
+    return value;
+}
+
+
+/* Add 1 to the value stored at a key and return the new value. */
+int increment_value_copy(hash_table *ht, char *key)
+{
+    return ++*find_or_insert_copy(ht, key);
+}
+
+
+int increment_value_n(hash_table *ht, char *key, size_t len)
+{
+    return ++*find_or_insert_n(ht, key, len);
+}
+
+
+int increment_value(hash_table *ht, char *key)
+{
+    return ++*find_or_insert(ht, key);
+}
+
+
+/*
+ * Set the value stored at a key.  If the key is not in the table,
+ * create a new entry and set the value to 'value'.  The table takes
+ * ownership of 'key'.
+ */
+void set_value(hash_table *ht, char *key, int value)
+{
+    *find_or_insert(ht, key) = value;
+}
+
+
+/* Print out the contents of the hash table as key/value pairs. */
+void print_hash_table(hash_table *ht)
+{
+    foreach_entry(ht, print_entry, NULL);
+}
+
+
+/* Print one key/value pair (expired keys never get here). */
+static void print_entry(char *key, int value, unsigned long hash,
+                        void *arg)
+{
+    printf("%s %d\n", key, value);
+}
+
+/* Call 'visit' on every key/value pair in the table. */
+void foreach_entry(hash_table *ht, entry_visitor visit, void *arg)
+{
+    visit_entries(ht, visit, arg, 1);
+}
+
+
+/*
+ * Visit every entry, or if 'live' is set only those that haven't
+ * expired.  The filter and the index are built from all of them.
+ */
+static void visit_entries(hash_table *ht, entry_visitor visit, void *arg,
+                          int live)
+{
+    unsigned long i;
+    entry *e;
+    i = 0;
+    while ((e = oa_next(&ht->table, &i)) != NULL)
+    {
+        if (!live || !is_expired(ht, e->key))
+        {
+            visit(e->key, e->value, e->hash, arg);
+        }
+    }
+}
+
+
+/*** Removal and expiry. ***/
+
+/*
+ * Keys are packed tightly until the first one is removed or given an
+ * expiry time.  From then on they are stored in blocks that can be
+ * handed back, and the keys already here are copied into such blocks
+ * (their packed copies stay where they are, so a stored key passed
+ * in still reads the same).  The index points at the keys, so it is
+ * built again; no key has an expiry time yet.
+ */
+static void reuse_keys(hash_table *ht)
+{
+    unsigned long i;
+    entry *e;
+    if (ARENA_REUSING(&ht->table.mem))
+    {
+        return;
+    }
+    arena_start_reuse(&ht->table.mem);
+    i = 0;
+    while ((e = oa_next(&ht->table, &i)) != NULL)
+    {
+        e->key = arena_strdup_reusable(&ht->table.mem, e->key,
+                                       strlen(e->key));
+    }
+    if (ht->order != NULL)
+    {
+        btree_free(ht->order);
+        free(ht->order);
+        ht->order = NULL;
+        add_ordered_index(ht);
+    }
+}
+
+
+int remove_key(hash_table *ht, char *key)
+{
+    str_view k;
+    entry *e;
+    char *stored;
+    int live;
+
+    reuse_keys(ht);
+    k.s = key;
+    k.len = strlen(key);
+    e = oa_find(&ht->table, k);
+    if (e == NULL)
+    {
+        return 0;
+    }
+
+    /* the key's bytes stay put until they are handed back below */
+    stored = e->key;
+    live = !is_expired(ht, stored);
+    oa_remove(&ht->table, e);
+    if (ht->order != NULL)
+    {
+        btree_remove(ht->order, stored);
+    }
+    clear_expiry(ht, stored);
+    if (ht->filter != NULL
+        && ++ht->filter->removed > ht->filter->capacity / 4)
+    {
+        rebuild_filter(ht, ht->filter->capacity);
+    }
+    arena_release(&ht->table.mem, stored, strlen(stored) + 1);
+    return live;
+}
+
+
+/* Give the table expiry times, if it hasn't any yet. */
+static void use_expiry(hash_table *ht)
+{
+    if (ht->expiry != NULL)
+    {
+        return;
+    }
+    ht->expiry = (key_expiry *) malloc(sizeof(key_expiry));
+    if (ht->expiry == NULL) memoryFail();
+    exp_init(&ht->expiry->times, hash_seed());
+    ht->expiry->now = 0;
+    ht->expiry->cursor = 0;
+}
+
+
+/* Has the stored key 'key' expired? */
+static int is_expired(hash_table *ht, char *key)
+{
+    expiry_entry *e;
+    if (ht->expiry == NULL || ht->expiry->times.count == 0)
+    {
+        return 0;
+    }
+    e = exp_find(&ht->expiry->times, (unsigned long) key);
+    return e != NULL && e->value <= ht->expiry->now;
+}
+
+
+/* Forget the expiry time of the stored key 'key', if it has one. */
+static void clear_expiry(hash_table *ht, char *key)
+{
+    expiry_entry *e;
+    if (ht->expiry == NULL || ht->expiry->times.count == 0)
+    {
+        return;
+    }
+    e = exp_find(&ht->expiry->times, (unsigned long) key);
+    if (e != NULL)
+    {
+        exp_remove(&ht->expiry->times, e);
+    }
+}
+
+
+int set_expiry(hash_table *ht, char *key, unsigned long when)
+{
+    str_view k;
+    entry *e;
+
+    reuse_keys(ht);
+    k.s = key;
+    k.len = strlen(key);
+    e = oa_find(&ht->table, k);
+    if (e == NULL)
+    {
+        return 0;
+    }
+    if (is_expired(ht, e->key))
+    {
+        remove_key(ht, e->key);
+        return 0;
+    }
+
+    if (when == 0)
+    {
+        clear_expiry(ht, e->key);
+    }
+    else
+    {
+        use_expiry(ht);
+        exp_find_or_insert(&ht->expiry->times,
+                           (unsigned long) e->key)->value = when;
+    }
+    return 1;
+}
+
+
+void set_clock(hash_table *ht, unsigned long now)
+{
+    use_expiry(ht);
+    ht->expiry->now = now;
+}
+
+
+/*
+ * Walk the expiry times from where the last call left off.  Removing
+ * a key moves the next entry back into the slot just checked, so the
+ * walk only moves on past slots it leaves alone.
+ */
+unsigned long expire_keys(hash_table *ht, unsigned long nslots)
+{
+    expiry_table *times;
+    expiry_entry *e;
+    unsigned long removed;
+
+    if (ht->expiry == NULL)
+    {
+        return 0;
+    }
+    times = &ht->expiry->times;
+    removed = 0;
+
+    for ( ; nslots > 0 && times->count > 0; nslots--)
+    {
+        e = &times->entry[ht->expiry->cursor & (times->nslots - 1)];
+        if (e->hash != 0 && e->value <= ht->expiry->now)
+        {
+            remove_key(ht, (char *) e->key);
+            removed++;
+        }
+        else
+        {
+            ht->expiry->cursor++;
+        }
+    }
+    return removed;
+}
+
+/*** Statistics. ***/
+
+void hash_table_stats(hash_table *ht, table_stats *s)
+{
+    unsigned long i, dist, mask;
+    entry *e;
+
+    memset(s, 0, sizeof(table_stats));
+    s->kind = "open addressing";
+    s->hist_label = "distance from home";
+    s->hist_unit = "keys";
+    s->count = ht->table.count;
+    s->nslots = ht->table.nslots;
+    mask = ht->table.nslots - 1;
+
+    i = 0;
+    while ((e = oa_next(&ht->table, &i)) != NULL)
+    {
+        dist = ((i - 1) - e->hash) & mask;
+        s->hist[dist < STATS_HIST ? dist : STATS_HIST]++;
+        if (dist + 1 > s->longest)
+        {
+            s->longest = dist + 1;
+        }
+        s->compares += dist + 1;
+    }
+
+    s->load = (double) s->count / s->nslots;
+    s->compares = s->count == 0 ? 0.0 : s->compares / s->count;
+    s->bytes = sizeof(hash_table) + ht->table.nslots * sizeof(entry)
+               + ht->table.mem.size;
+    if (ht->order != NULL)
+    {
+        s->bytes += sizeof(btree) + ht->order->mem.size;
+    }
+    if (ht->expiry != NULL)
+    {
+        s->bytes += sizeof(key_expiry)
+                    + ht->expiry->times.nslots * sizeof(expiry_entry);
+    }
+    s->filter_fp = -1.0;
+    if (ht->filter != NULL)
+    {
+        s->bytes += sizeof(bloom_filter)
+                    + ht->filter->nblocks * BLOOM_BLOCK_BYTES;
+        s->filter_fp = bloom_false_positive_rate(ht->filter);
+    }
+#ifdef HASH_TABLE_STATS
+    s->counted = 1;
+    s->ops = ht->table.ops;
+#endif
+}
+
+
+/*** Bloom filter. ***/
+
+static void filter_key(char *key, int value, unsigned long hash, void *arg)
+{
+    bloom_add((bloom_filter *) arg, hash);
+}
+
+
+/* Refill the filter from the hashes in the entries. */
+static void rebuild_filter(hash_table *ht, unsigned long capacity)
+{
+    bloom_resize(ht->filter, capacity);
+    visit_entries(ht, filter_key, ht->filter, 0);
+}
+
+
+void add_bloom_filter(hash_table *ht, unsigned long expected)
+{
+    if (ht->filter != NULL)
+    {
+        return;
+    }
+    ht->filter = (bloom_filter *) malloc(sizeof(bloom_filter));
+    if (ht->filter == NULL) memoryFail();
+    bloom_init(ht->filter, expected > ht->table.count
+                           ? expected : ht->table.count);
+    visit_entries(ht, filter_key, ht->filter, 0);
+}
+
+
+/*** Ordered index. ***/
+
+static void index_key(char *key, int value, unsigned long hash, void *arg)
+{
+    btree_insert((btree *) arg, key);
+}
+
+
+void add_ordered_index(hash_table *ht)
+{
+    if (ht->order != NULL)
+    {
+        return;
+    }
+    ht->order = (btree *) malloc(sizeof(btree));
+    if (ht->order == NULL) memoryFail();
+    btree_init(ht->order);
+    visit_entries(ht, index_key, ht->order, 0);
+}
+
+
+void find_range(hash_table *ht, char *lo, char *hi, key_range *r)
+{
+    add_ordered_index(ht);
+    r->ht = ht;
+    r->hi = hi;
+    btree_seek(ht->order, &r->cursor, lo);
+}
+
+
+int next_in_range(key_range *r, char **key, int *value)
+{
+    char *k;
+    do
+    {
+        k = btree_next(&r->cursor);
+        if (k == NULL || (r->hi != NULL && strcmp(k, r->hi) >= 0))
+        {
+            r->cursor.depth = 0;
+            return 0;
+        }
+    } while (is_expired(r->ht, k));
+    *key = k;
+    *value = get_value(r->ht, k);
+    return 1;
+}
+
+
+void memoryFail(void)
+{
+    printf("Failed to allocate memory; exiting\n");
+    exit(1);
+}
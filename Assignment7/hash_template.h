@@ -0,0 +1,451 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: hash_template.h
+ *
+ *       Open addressing hash tables for any key and value types,
+ *       generated by macros.  Each instantiation gets its own entry
+ *       and table structs and its own copy of the functions, with the
+ *       hash and the key comparison expanded in place, so there is no
+ *       call through a function pointer and the compiler sees the
+ *       actual types.
+ *
+ *       The string -> int table of hash_table_oa.c is one of these;
+ *       template_test.c makes a few others.
+ *
+ */
+
+#ifndef HASH_TEMPLATE_H
+#define HASH_TEMPLATE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "arena.h"
+
+/*
+ * The generated functions are static, and marked inline so that the
+ * ones a file doesn't use cost nothing and draw no warnings.
+ */
+#ifdef __GNUC__
+#define HT_INLINE __inline__
+#else
+#define HT_INLINE
+#endif
+
+/*
+ * Ask for the cache line at 'addr' to be loaded, without waiting for
+ * it.  Lookups done in batches use this to have the memory of many
+ * keys on its way at once.
+ */
+#ifdef __GNUC__
+#define HT_PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define HT_PREFETCH(addr) ((void) 0)
+#endif
+
+/* Initial number of entries (a power of two). */
+#define HT_NSLOTS 128
+
+/*
+ * The table grows (doubles, all at once) when more than HT_MAX_LOAD
+ * percent of its entries are in use.
+ */
+#define HT_MAX_LOAD 80
+
+/*
+ * In a build with -DHASH_TABLE_STATS every table also counts what it
+ * does, in a field 'ops' (hash_table_stats reports it).  Otherwise
+ * the counting compiles to nothing.
+ */
+
+typedef struct
+{
+    unsigned long lookups;      /* keys looked up, found or not      */
+    unsigned long inserts;      /* keys added                        */
+    unsigned long compares;     /* entries or nodes looked at        */
+    unsigned long resizes;      /* times the table grew              */
+} ht_counters;
+
+#ifdef HASH_TABLE_STATS
+#define HT_COUNTERS             ht_counters ops;
+#define HT_COUNT(ht, what, n)   ((ht)->ops.what += (n))
+#define HT_RESET_COUNTERS(ht)   memset(&(ht)->ops, 0, sizeof(ht_counters))
+#else
+#define HT_COUNTERS
+#define HT_COUNT(ht, what, n)   ((void) 0)
+#define HT_RESET_COUNTERS(ht)   ((void) 0)
+#endif
+
+
+/*
+ * The types.  HASH_TABLE_TYPES(table_t, entry_t, key_t, value_t);
+ * declares
+ *
+ *   entry_t    an entry: the key's hash, the key and the value.  The
+ *              hash is never 0 in a used entry and 0 in an empty one,
+ *              so any key type can be stored.
+ *   table_t    the table: a flat array of 'nslots' entries, using
+ *              linear probing with Robin Hood insertion (an entry's
+ *              distance from its home slot, hash & (nslots - 1), is
+ *              never less than that of the entry before it, so a
+ *              lookup can stop as soon as it passes the point where
+ *              its key would have been placed).  'mem' is there for
+ *              keys that need storage of their own.
+ */
+#define HASH_TABLE_TYPES(table_t, entry_t, key_t, value_t)                  \
+    typedef struct                                                          \
+    {                                                                       \
+        unsigned long hash;                                                 \
+        key_t key;                                                          \
+        value_t value;                                                      \
+    } entry_t;                                                              \
+                                                                            \
+    typedef struct                                                          \
+    {                                                                       \
+        entry_t *entry;                                                     \
+        unsigned long nslots;   /* size of 'entry', a power of two   */     \
+        unsigned long count;    /* number of keys in the table       */     \
+        unsigned long seed;     /* random seed for the hash          */     \
+        arena mem;              /* storage for the keys, if needed   */     \
+        HT_COUNTERS                                                         \
+    } table_t
+
+
+/*
+ * The functions.  HASH_TABLE_FUNCTIONS(prefix, table_t, entry_t,
+ * lookup_t, HASH, EQUAL, STORE) (with no semicolon after it) defines
+ *
+ *   void     prefix_init(table_t *ht, unsigned long seed)
+ *   void     prefix_destroy(table_t *ht)
+ *   entry_t *prefix_find(table_t *ht, lookup_t k)
+ *   entry_t *prefix_find_or_insert(table_t *ht, lookup_t k)
+ *   void     prefix_remove(table_t *ht, entry_t *e)
+ *   entry_t *prefix_next(table_t *ht, unsigned long *i)
+ *
+ * and, for callers that need a key's hash themselves,
+ *
+ *   unsigned long prefix_hash(table_t *ht, lookup_t k)
+ *   entry_t *prefix_find_hashed(table_t *ht, lookup_t k, unsigned long h)
+ *   entry_t *prefix_find_or_insert_hashed(table_t *ht, lookup_t k,
+ *                                         unsigned long h)
+ *   entry_t *prefix_insert_new(table_t *ht, lookup_t k, unsigned long h)
+ *   void     prefix_prefetch(table_t *ht, unsigned long h)
+ *
+ * 'lookup_t' is what a key is looked up by.  It can differ from the
+ * stored key type: string tables look keys up by a str_view into the
+ * input and store a copy.  The three macro arguments say how to use
+ * it:
+ *
+ *   HASH(k, seed)      the hash of lookup key 'k', an unsigned long
+ *   EQUAL(key, k)      nonzero if stored 'key' is lookup key 'k'
+ *   STORE(ht, k)       the key to store for 'k' when it's added
+ *
+ * prefix_find returns NULL for a missing key.  prefix_find_or_insert
+ * adds a missing key with a value of all zero bytes; the entry
+ * pointer it returns is only good until the next key is added.
+ * prefix_insert_new adds a key the caller knows isn't there, without
+ * looking for it.  prefix_prefetch starts loading the home entry of
+ * hash 'h', for a prefix_find_hashed of it a little later.
+ * prefix_remove takes out the entry 'e' points to (one found by the
+ * other functions) and moves the entries after it in its run back a
+ * place ("backward shift"), so no tombstones are needed and probes
+ * stay as short as if the key had never been added.  It doesn't
+ * reclaim a stored key's storage: a table that needs that stores keys
+ * with STR_STORE_REUSABLE and hands them back with arena_release.
+ * prefix_next walks the entries: start with *i = 0 and call it until
+ * it returns NULL.  The table must not be changed during the walk.
+ */
+#define HASH_TABLE_FUNCTIONS(prefix, table_t, entry_t, lookup_t,            \
+                             HASH, EQUAL, STORE)                            \
+                                                                            \
+    static HT_INLINE entry_t *prefix##_create_entries(unsigned long n)     \
+    {                                                                       \
+        entry_t *e;                                                         \
+        e = (entry_t *) calloc(n, sizeof(entry_t));                         \
+        if (e == NULL)                                                      \
+        {                                                                   \
+            printf("Failed to allocate memory; exiting\n");                 \
+            exit(1);                                                        \
+        }                                                                   \
+        return e;                                                           \
+    }                                                                       \
+                                                                            \
+    static HT_INLINE void prefix##_init(table_t *ht, unsigned long seed)    \
+    {                                                                       \
+        ht->entry = prefix##_create_entries(HT_NSLOTS);                     \
+        ht->nslots = HT_NSLOTS;                                             \
+        ht->count = 0;                                                      \
+        ht->seed = seed;                                                    \
+        arena_init(&ht->mem);                                               \
+        HT_RESET_COUNTERS(ht);                                              \
+    }                                                                       \
+                                                                            \
+    static HT_INLINE void prefix##_destroy(table_t *ht)                     \
+    {                                                                       \
+        free(ht->entry);                                                    \
+        arena_free(&ht->mem);                                               \
+    }                                                                       \
+                                                                            \
+    /* The hash of 'k', kept clear of 0, which marks empty entries. */     \
+    static HT_INLINE unsigned long prefix##_hash(table_t *ht, lookup_t k)   \
+    {                                                                       \
+        unsigned long h;                                                    \
+        h = HASH(k, ht->seed);                                              \
+        return h != 0 ? h : 1;                                              \
+    }                                                                       \
+                                                                            \
+    /*                                                                      \
+     * Put an entry whose key isn't in the table into it, starting the      \
+     * probe at index 'i', 'dist' entries from its home slot.  The new      \
+     * entry takes the place of the first entry that is closer to its       \
+     * home slot than the new one is, and that entry moves on in its        \
+     * stead.  Returns where the new entry ended up.                        \
+     */                                                                     \
+    static HT_INLINE entry_t *prefix##_insert_entry(table_t *ht, entry_t e, \
+                                                    unsigned long i,        \
+                                                    unsigned long dist)     \
+    {                                                                       \
+        unsigned long mask, edist;                                          \
+        entry_t tmp, *placed;                                               \
+        mask = ht->nslots - 1;                                              \
+        placed = NULL;                                                      \
+        for ( ; ; dist++)                                                   \
+        {                                                                   \
+            if (ht->entry[i].hash == 0)                                     \
+            {                                                               \
+                ht->entry[i] = e;                                           \
+                return placed != NULL ? placed : &ht->entry[i];             \
+            }                                                               \
+            edist = (i - ht->entry[i].hash) & mask;                         \
+            if (edist < dist)                                               \
+            {                                                               \
+                tmp = ht->entry[i];                                         \
+                ht->entry[i] = e;                                           \
+                e = tmp;                                                    \
+                dist = edist;                                               \
+                if (placed == NULL) placed = &ht->entry[i];                 \
+            }                                                               \
+            i = (i + 1) & mask;                                             \
+        }                                                                   \
+    }                                                                       \
+                                                                            \
+    /* Double the number of entries and reinsert everything. */            \
+    static HT_INLINE void prefix##_grow(table_t *ht)                        \
+    {                                                                       \
+        entry_t *old;                                                       \
+        unsigned long i, old_nslots;                                        \
+        old = ht->entry;                                                    \
+        old_nslots = ht->nslots;                                            \
+        ht->nslots *= 2;                                                    \
+        ht->entry = prefix##_create_entries(ht->nslots);                    \
+        HT_COUNT(ht, resizes, 1);                                           \
+        for (i = 0; i < old_nslots; i++)                                    \
+        {                                                                   \
+            if (old[i].hash != 0)                                           \
+            {                                                               \
+                prefix##_insert_entry(ht, old[i],                           \
+                                      old[i].hash & (ht->nslots - 1), 0);   \
+            }                                                               \
+        }                                                                   \
+        free(old);                                                          \
+    }                                                                       \
+                                                                            \
+    static HT_INLINE entry_t *prefix##_find_hashed(table_t *ht, lookup_t k, \
+                                                   unsigned long h)         \
+    {                                                                       \
+        unsigned long mask, i, dist;                                        \
+        entry_t *e;                                                         \
+        mask = ht->nslots - 1;                                              \
+        i = h & mask;                                                       \
+        HT_COUNT(ht, lookups, 1);                                           \
+        for (dist = 0; ; dist++)                                            \
+        {                                                                   \
+            e = &ht->entry[i];                                              \
+            HT_COUNT(ht, compares, 1);                                      \
+            if (e->hash == 0 || ((i - e->hash) & mask) < dist)              \
+            {                                                               \
+                return NULL;                                                \
+            }                                                               \
+            if (e->hash == h && EQUAL(e->key, k))                           \
+            {                                                               \
+                return e;                                                   \
+            }                                                               \
+            i = (i + 1) & mask;                                             \
+        }                                                                   \
+    }                                                                       \
+                                                                            \
+    static HT_INLINE void prefix##_prefetch(table_t *ht, unsigned long h)   \
+    {                                                                       \
+        HT_PREFETCH(&ht->entry[h & (ht->nslots - 1)]);                      \
+    }                                                                       \
+                                                                            \
+    static HT_INLINE entry_t *prefix##_find(table_t *ht, lookup_t k)        \
+    {                                                                       \
+        return prefix##_find_hashed(ht, k, prefix##_hash(ht, k));           \
+    }                                                                       \
+                                                                            \
+    /*                                                                      \
+     * A miss is inserted where the lookup's probe stopped, so the key      \
+     * is hashed and probed for once.  The table grows up front if one      \
+     * more key would take it over HT_MAX_LOAD, as growing afterwards       \
+     * would move the entry.                                                \
+     */                                                                     \
+    static HT_INLINE entry_t *prefix##_find_or_insert_hashed(table_t *ht,   \
+                                                             lookup_t k,    \
+                                                             unsigned long h) \
+    {                                                                       \
+        entry_t *e, new_entry;                                              \
+        unsigned long mask, i, dist;                                        \
+        if ((ht->count + 1) * 100 > ht->nslots * HT_MAX_LOAD)               \
+        {                                                                   \
+            prefix##_grow(ht);                                              \
+        }                                                                   \
+        mask = ht->nslots - 1;                                              \
+        i = h & mask;                                                       \
+        HT_COUNT(ht, lookups, 1);                                           \
+        for (dist = 0; ; dist++)                                            \
+        {                                                                   \
+            e = &ht->entry[i];                                              \
+            HT_COUNT(ht, compares, 1);                                      \
+            if (e->hash == 0 || ((i - e->hash) & mask) < dist)              \
+            {                                                               \
+                break;                                                      \
+            }                                                               \
+            if (e->hash == h && EQUAL(e->key, k))                           \
+            {                                                               \
+                return e;                                                   \
+            }                                                               \
+            i = (i + 1) & mask;                                             \
+        }                                                                   \
+        memset(&new_entry, 0, sizeof(new_entry));                           \
+        new_entry.hash = h;                                                 \
+        new_entry.key = STORE(ht, k);                                       \
+        ht->count++;                                                        \
+        HT_COUNT(ht, inserts, 1);                                           \
+        return prefix##_insert_entry(ht, new_entry, i, dist);               \
+    }                                                                       \
+                                                                            \
+    static HT_INLINE entry_t *prefix##_find_or_insert(table_t *ht,          \
+                                                      lookup_t k)           \
+    {                                                                       \
+        return prefix##_find_or_insert_hashed(ht, k, prefix##_hash(ht, k)); \
+    }                                                                       \
+                                                                            \
+    /* Robin Hood insertion from the home slot finds the key's place. */   \
+    static HT_INLINE entry_t *prefix##_insert_new(table_t *ht, lookup_t k,  \
+                                                  unsigned long h)          \
+    {                                                                       \
+        entry_t new_entry;                                                  \
+        if ((ht->count + 1) * 100 > ht->nslots * HT_MAX_LOAD)               \
+        {                                                                   \
+            prefix##_grow(ht);                                              \
+        }                                                                   \
+        memset(&new_entry, 0, sizeof(new_entry));                           \
+        new_entry.hash = h;                                                 \
+        new_entry.key = STORE(ht, k);                                       \
+        ht->count++;                                                        \
+        HT_COUNT(ht, lookups, 1);                                           \
+        HT_COUNT(ht, inserts, 1);                                           \
+        return prefix##_insert_entry(ht, new_entry, h & (ht->nslots - 1), 0); \
+    }                                                                       \
+                                                                            \
+    /*                                                                      \
+     * Each following entry that isn't in its home slot moves back one;     \
+     * Robin Hood order is kept, as they all get one closer to home.        \
+     */                                                                     \
+    static HT_INLINE void prefix##_remove(table_t *ht, entry_t *e)          \
+    {                                                                       \
+        unsigned long mask, i, j;                                           \
+        mask = ht->nslots - 1;                                              \
+        i = e - ht->entry;                                                  \
+        for (j = (i + 1) & mask;                                            \
+             ht->entry[j].hash != 0                                         \
+             && ((j - ht->entry[j].hash) & mask) != 0;                      \
+             j = (j + 1) & mask)                                            \
+        {                                                                   \
+            ht->entry[i] = ht->entry[j];                                    \
+            i = j;                                                          \
+        }                                                                   \
+        memset(&ht->entry[i], 0, sizeof(entry_t));                          \
+        ht->count--;                                                        \
+    }                                                                       \
+                                                                            \
+    static HT_INLINE entry_t *prefix##_next(table_t *ht, unsigned long *i)  \
+    {                                                                       \
+        for ( ; *i < ht->nslots; (*i)++)                                    \
+        {                                                                   \
+            if (ht->entry[*i].hash != 0)                                    \
+            {                                                               \
+                return &ht->entry[(*i)++];                                  \
+            }                                                               \
+        }                                                                   \
+        return NULL;                                                        \
+    }
+
+
+/*** Keys for the common cases. ***/
+
+/*
+ * String keys, stored as a zero-terminated copy in the table's arena
+ * and looked up by a view of 'len' bytes that needn't be terminated.
+ * These use hash_n from hash_table.h.  A table that removes keys
+ * stores them with STR_STORE_REUSABLE instead.  That packs them as
+ * STR_STORE does until arena_start_reuse(&ht->mem) is called, and
+ * rounds them up to a block that can be handed back after; the table
+ * must call it, and copy the keys it already has again, before it
+ * hands back a key with arena_release(&ht->mem, key, strlen(key) + 1).
+ */
+
+typedef struct
+{
+    char *s;
+    size_t len;
+} str_view;
+
+#define STR_HASH(k, seed)   hash_n((k).s, (k).len, (seed))
+#define STR_EQUAL(key, k)   (strncmp((key), (k).s, (k).len) == 0 \
+                             && (key)[(k).len] == '\0')
+#define STR_STORE(ht, k)    arena_strdup(&(ht)->mem, (k).s, (k).len)
+#define STR_STORE_REUSABLE(ht, k)                                   \
+    (ARENA_REUSING(&(ht)->mem)                                      \
+     ? arena_strdup_reusable(&(ht)->mem, (k).s, (k).len)            \
+     : arena_strdup(&(ht)->mem, (k).s, (k).len))
+
+/*
+ * Integer keys, stored and looked up as an unsigned long (64 bits on
+ * the machines this is built on).  The hash is the MurmurHash3
+ * finalizer of the key mixed with the seed.
+ */
+
+#if ULONG_MAX > 0xffffffffUL
+#define HT_FMIX_M1  0xff51afd7ed558ccdUL
+#define HT_FMIX_M2  0xc4ceb9fe1a85ec53UL
+#define HT_FMIX_S1  33
+#define HT_FMIX_S2  33
+#define HT_FMIX_S3  33
+#else
+#define HT_FMIX_M1  0x85ebca6bUL
+#define HT_FMIX_M2  0xc2b2ae35UL
+#define HT_FMIX_S1  16
+#define HT_FMIX_S2  13
+#define HT_FMIX_S3  16
+#endif
+
+static HT_INLINE unsigned long hash_ulong(unsigned long k, unsigned long seed)
+{
+    k ^= seed;
+    k ^= k >> HT_FMIX_S1;
+    k *= HT_FMIX_M1;
+    k ^= k >> HT_FMIX_S2;
+    k *= HT_FMIX_M2;
+    k ^= k >> HT_FMIX_S3;
+    return k;
+}
+
+#define ULONG_HASH(k, seed)     hash_ulong((k), (seed))
+#define ULONG_EQUAL(key, k)     ((key) == (k))
+#define ULONG_STORE(ht, k)      (k)
+
+#endif  /* HASH_TEMPLATE_H */
@@ -36,93 +36,336 @@
 #include <stdlib.h>
 #include <string.h>
 #include "hash_table.h"
+#include "tokenizer.h"
+#include "parallel.h"
+#include "report.h"
+#include "snapshot.h"
+#include "stream.h"
 #include "memcheck.h"
 
-#define MAX_WORD_LENGTH 100
-
 
 void usage(char *progname)
 {
-    fprintf(stderr, "usage: %s filename\n", progname);
+    fprintf(stderr, "usage: %s [-j nthreads] [-k K | -s count|key | "
+                    "-f from -t to] [-w snapshot] [-S statsfile] "
+                    "filename\n", progname);
+    fprintf(stderr, "       %s [-i every] [-m maxkeys] [-k K | -s count|key] "
+                    "-\n", progname);
+    fprintf(stderr, "       %s -r snapshot [filename]\n", progname);
+    fprintf(stderr, "  -j  count with this many threads\n");
+    fprintf(stderr, "  -k  print only the K most frequent words\n");
+    fprintf(stderr, "  -s  print all the words, sorted by count "
+                    "(highest first) or by word\n");
+    fprintf(stderr, "  -f  print only the words from this one on, in order\n");
+    fprintf(stderr, "  -t  print only the words before this one, in order\n");
+    fprintf(stderr, "  -w  also save the counts to a snapshot file\n");
+    fprintf(stderr, "  -S  write statistics of the tables to a file\n");
+    fprintf(stderr, "  -r  print the counts saved in a snapshot, or look "
+                    "up each word of\n      'filename' in it\n");
+    fprintf(stderr, "  -   count the words of standard input as they come\n");
+    fprintf(stderr, "  -i  and report the top K (default %d) every so many "
+                    "words\n", STREAM_TOP_K);
+    fprintf(stderr, "  -m  and keep at most this many words, with "
+                    "approximate counts for\n      the rest\n");
 }
 
-void add_to_hash_table(hash_table *ht, char *key)
+
+/*
+ * Print the counts stored in a snapshot, or if there is an input file
+ * look each of its words up in the snapshot.
+ */
+int read_snapshot(char *snapname, char *filename)
 {
-    int v = get_value(ht, key);
-    set_value(ht, key, v + 1);
+    hash_snapshot *snap;
+    input_file input;
+    tokenizer  words;
+    char      *word;
+    size_t     len;
+
+    snap = load_hash_table(snapname);
+
+    if (snap == NULL)
+    {
+        fprintf(stderr, "Can't read the snapshot \"%s\"! "
+                        "Terminating program.\n", snapname);
+        return 1;
+    }
+
+    if (filename == NULL)
+    {
+        print_snapshot(snap);
+    }
+    else
+    {
+        if (open_input_file(filename, &input) < 0)
+        {
+            fprintf(stderr, "Input file \"%s\" does not exist! "
+                            "Terminating program.\n", filename);
+            close_snapshot(snap);
+            return 1;
+        }
+
+        init_tokenizer(&words, input.data, input.size);
+
+        while (next_word(&words, &word, &len))
+        {
+            printf("%.*s %d\n", (int) len, word,
+                   snapshot_get_value_n(snap, word, len));
+        }
+
+        close_input_file(&input);
+    }
+
+    close_snapshot(snap);
+    print_memory_leaks();
+    return 0;
+}
+
+/* Write the statistics of each table to 'filename'. */
+void write_stats(hash_table **tables, int ntables, char *filename)
+{
+    FILE *fp;
+    table_stats s;
+    int i;
+
+    fp = fopen(filename, "w");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "Can't write the statistics to \"%s\"!\n",
+                filename);
+        return;
+    }
+
+    for (i = 0; i < ntables; i++)
+    {
+        if (ntables > 1)
+        {
+            fprintf(fp, "Table %d of %d: ", i + 1, ntables);
+        }
+        hash_table_stats(tables[i], &s);
+        print_table_stats(fp, &s);
+    }
+
+    fclose(fp);
+}
+
+
+/*
+ * The word is a view into the input file; the table copies it the
+ * first time it sees it.
+ */
+void add_to_hash_table(hash_table *ht, char *word, size_t len)
+{
+    increment_value_n(ht, word, len);
 }
 
 
 int main(int argc, char **argv)
 {
-    int   nwords;
-    FILE *input_file;
-    char  word[MAX_WORD_LENGTH];
-    char  line[MAX_WORD_LENGTH];
-    char *new_word;
-    hash_table *ht;
+    input_file input;
+    tokenizer  words;
+    char      *word;
+    size_t     len;
+    char      *filename, *save_name, *read_name, *from, *to, *stats_name;
+    int        i, argi, nthreads, ntables, order;
+    long       top_k;
+    count_entry *counts;
+    size_t     ncounts;
+    hash_table *tables[MAX_THREADS];
+    stream_options stream;
+
+    nthreads = 1;
+    top_k = -1;
+    order = -1;
+    save_name = NULL;
+    read_name = NULL;
+    from = NULL;
+    to = NULL;
+    stats_name = NULL;
+    stream.every = 0;
+    stream.max_keys = 0;
+
+    for (argi = 1; argi + 1 < argc && argv[argi][0] == '-'; argi += 2)
+    {
+        if (strcmp(argv[argi], "-j") == 0)
+        {
+            nthreads = atoi(argv[argi + 1]);
+        }
+        else if (strcmp(argv[argi], "-k") == 0)
+        {
+            top_k = atol(argv[argi + 1]);
+        }
+        else if (strcmp(argv[argi], "-s") == 0
+                 && strcmp(argv[argi + 1], "count") == 0)
+        {
+            order = BY_COUNT;
+        }
+        else if (strcmp(argv[argi], "-s") == 0
+                 && strcmp(argv[argi + 1], "key") == 0)
+        {
+            order = BY_KEY;
+        }
+        else if (strcmp(argv[argi], "-f") == 0)
+        {
+            from = argv[argi + 1];
+        }
+        else if (strcmp(argv[argi], "-t") == 0)
+        {
+            to = argv[argi + 1];
+        }
+        else if (strcmp(argv[argi], "-w") == 0)
+        {
+            save_name = argv[argi + 1];
+        }
+        else if (strcmp(argv[argi], "-r") == 0)
+        {
+            read_name = argv[argi + 1];
+        }
+        else if (strcmp(argv[argi], "-S") == 0)
+        {
+            stats_name = argv[argi + 1];
+        }
+        else if (strcmp(argv[argi], "-i") == 0)
+        {
+            stream.every = strtoul(argv[argi + 1], NULL, 10);
+        }
+        else if (strcmp(argv[argi], "-m") == 0)
+        {
+            stream.max_keys = strtoul(argv[argi + 1], NULL, 10);
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (read_name != NULL && argi >= argc - 1)
+    {
+        return read_snapshot(read_name, argi == argc - 1 ? argv[argi] : NULL);
+    }
 
-    if (argc != 2)
+    if (argi != argc - 1 || top_k < -1 || (top_k >= 0 && order >= 0)
+        || ((from != NULL || to != NULL) && (top_k >= 0 || order >= 0))
+        || read_name != NULL)
     {
         usage(argv[0]);
         exit(1);
     }
 
-    /* Make the hash table. */
-    ht = create_hash_table();
+    filename = argv[argi];
 
+    if ((stream.every > 0 || stream.max_keys > 0)
+        && strcmp(filename, "-") != 0)
+    {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    if (nthreads < 1 || nthreads > MAX_THREADS)
+    {
+        fprintf(stderr, "The number of threads must be from 1 to %d.\n",
+                MAX_THREADS);
+        exit(1);
+    }
+
+    if (strcmp(filename, "-") == 0)
+    {
+        if (nthreads > 1)
+        {
+            fprintf(stderr, "Standard input is counted with one thread.\n");
+            exit(1);
+        }
+
+        /* Count standard input as it is read; there is no file. */
+        input.data = NULL;
+        input.mapped = 0;
+        stream.top_k = top_k >= 0 ? top_k : STREAM_TOP_K;
+        tables[0] = count_stream(0, &stream);
+        ntables = 1;
+    }
     /*
-     * Open the input file.  For simplicity, we specify that the
-     * input file has to contain exactly one word per line.
+     * Open the input file.  It is mapped into memory whole and split
+     * into words at whitespace, so words can be any length and there
+     * can be any number of them on a line.
      */
-    input_file = fopen(argv[1], "r");
-
-    if (input_file == NULL)  /* Open failed. */
+    else if (open_input_file(filename, &input) < 0)  /* Open failed. */
     {
         fprintf(stderr, "Input file \"%s\" does not exist! "
-                        "Terminating program.\n", argv[1]);
+                        "Terminating program.\n", filename);
         return 1;
     }
-
-    /* Add the words to the hash table until there are none left. */
-
-    while (fgets(line, MAX_WORD_LENGTH, input_file) != NULL)
+    else if (nthreads > 1)
+    {
+        /*
+         * Count in parallel.  The counts come back split over
+         * 'nthreads' tables with no keys in common.
+         */
+        count_words_parallel(input.data, input.size, nthreads, tables);
+        ntables = nthreads;
+    }
+    else
     {
-        /* Clear the contents of 'word'. */
-        word[0] = '\0';
+        /* Make the hash table. */
+        tables[0] = create_hash_table();
+        ntables = 1;
 
-        /* Convert the line to a word. */
-        nwords = sscanf(line, "%s", word);
+        /* Add the words to the hash table until there are none left. */
 
-        if (nwords != 1)  /* Conversion failed, e.g. due to a blank line. */
+        init_tokenizer(&words, input.data, input.size);
+
+        while (next_word(&words, &word, &len))
         {
-            continue;
+            add_to_hash_table(tables[0], word, len);
         }
-        else
-        {
-            /* Copy the word.  Add 1 for the zero byte at the end. */
-            new_word = (char *)calloc(strlen(word) + 1, sizeof(char));
+    }
 
-            if (new_word == NULL)
-            {
-                fprintf(stderr, "Error: memory allocation failed! "
-                                "Terminating program.\n");
-                return 1;
-            }
+    if (save_name != NULL && save_hash_tables(tables, ntables, save_name) < 0)
+    {
+        fprintf(stderr, "Can't write the snapshot \"%s\"!\n", save_name);
+    }
 
-            strcpy(new_word, word);
+    if (stats_name != NULL)
+    {
+        write_stats(tables, ntables, stats_name);
+    }
 
-            /* Add it to the hash table. */
-            add_to_hash_table(ht, new_word);
+    /* Print out the hash table key/value pairs. */
+    if (from != NULL || to != NULL)
+    {
+        print_range(tables, ntables, from, to);
+    }
+    else if (top_k < 0 && order < 0)
+    {
+        for (i = 0; i < ntables; i++)
+        {
+            print_hash_table(tables[i]);
         }
     }
+    else
+    {
+        /* Listings work on an array of the pairs, not on the tables. */
+        counts = extract_counts(tables, ntables, &ncounts);
 
-    /* Print out the hash table key/value pairs. */
-    print_hash_table(ht);
+        if (top_k >= 0)
+        {
+            ncounts = top_counts(counts, ncounts, top_k);
+        }
+        else
+        {
+            sort_counts(counts, ncounts, order, nthreads);
+        }
+
+        print_counts(counts, ncounts);
+        free(counts);
+    }
 
     /* Clean up. */
-    free_hash_table(ht);
-    fclose(input_file);
+    for (i = 0; i < ntables; i++)
+    {
+        free_hash_table(tables[i]);
+    }
+
+    close_input_file(&input);
 
     /* Check for memory leaks. */
     print_memory_leaks();
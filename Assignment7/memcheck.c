@@ -3,17 +3,29 @@
  *
  *       Simple-minded memory leak checker for C programs.
  *
+ *       Each thread keeps its allocations in a shard of its own, so
+ *       allocating and freeing take no lock.  Memory freed by another
+ *       thread than the one that allocated it is handed back to the
+ *       owning shard on a lock-free list.  There are no portable C89
+ *       atomics, so this uses the GCC __atomic and __sync builtins.
+ *
  */
 
+#define _POSIX_C_SOURCE 200112L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
 #define MEMCHECK_C
 #include "memcheck.h"
 
 #define DEBUG 0
 
+#define LOAD(p)        __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE(p, v)    __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
 /*
  * Definition of data structure to keep memory allocation information.
  */
@@ -25,21 +37,94 @@ struct _mem_node
     size_t  nbytes;     /* Number of bytes allocated.                     */
     char   *filename;   /* Name of file where allocation occurred.        */
     int     lineno;     /* Line number of file where allocation occurred. */
-    struct _mem_node *next;     /* Next node in linked list. */
+    struct _mem_node *next;     /* Next node in the bucket (or free list). */
 }
 mem_node;
 
+/*
+ * The nodes are allocated NODE_BLOCK at a time, and the blocks are
+ * kept in a list so they can be freed at the end.
+ */
+
+#define NODE_BLOCK 256
+
+typedef
+struct _node_block
+{
+    struct _node_block *next;
+    mem_node nodes[NODE_BLOCK];
+}
+node_block;
+
+/*
+ * A shard's table starts with MIN_BUCKETS buckets (a power of two),
+ * and doubles them whenever it holds more nodes than buckets.
+ */
+
+#define MIN_BUCKETS 1024
+
+/*
+ * Every allocation is preceded by a header saying which shard it is
+ * in.  The union makes the header a multiple of the strictest
+ * alignment, so the memory after it is aligned as malloc's is.
+ */
+
+#define HEADER_LIVE   0x6d656d63UL  /* allocated                      */
+#define HEADER_HANDED 0x68616e64UL  /* freed, on its shard's 'remote' */
+
+struct _shard;
+
+typedef
+union _mem_header
+{
+    struct
+    {
+        struct _shard     *owner;   /* Shard the memory is tracked in.  */
+        union _mem_header *next;    /* Next in the shard's 'remote'.    */
+        unsigned long      state;   /* HEADER_LIVE, HEADER_HANDED or 0. */
+    } h;
+    long double align_ld;
+    double      align_d;
+    void       *align_p;
+    long        align_l;
+}
+mem_header;
+
+#define HEADER_OF(p) ((mem_header *)(p) - 1)
+#define MEMORY_OF(h) ((void *)((mem_header *)(h) + 1))
+
+/*
+ * The allocations of one thread, in a hash table keyed by address.
+ * Only the thread using the shard touches the table; other threads
+ * only push what they free onto 'remote'.  When a thread exits its
+ * shard is marked not in use, and the next new thread takes it over,
+ * allocations and all.
+ */
+
+typedef
+struct _shard
+{
+    mem_node      **buckets;
+    unsigned long   nbuckets;   /* a power of two, once there are any */
+    unsigned long   count;      /* nodes in the table                 */
+    mem_node       *free_nodes;
+    node_block     *blocks;
+    mem_header     *remote;     /* freed by other threads             */
+    int             in_use;     /* a thread has it                    */
+    struct _shard  *next;       /* next in the list of all shards     */
+}
+shard;
+
 
 /*
  * Function prototypes.
  */
 
-void        allocate_mem_node(void *addr, size_t nbytes,
+void        allocate_mem_node(shard *s, void *addr, size_t nbytes,
                               char *filename, int lineno);
-void        free_mem_node(mem_node *n);
-void        free_mem_node_and_adjust_pool(mem_node *n);
-void        free_all_mem_nodes(void);
-mem_node   *find_node(void *addr);
+void        free_mem_node(shard *s, mem_node **link);
+void        free_all_mem_nodes(shard *s);
+mem_node  **find_link(shard *s, void *addr);
 void       *checked_malloc_fn(size_t size, char *filename, int lineno);
 void       *checked_calloc_fn(size_t nmemb, size_t size,
                               char *filename, int lineno);
@@ -47,192 +132,477 @@ void        checked_free_fn(void *ptr, char *filename, int lineno);
 void        print_memory_leaks(void);
 void        dump_pool(void);
 
+static void          out_of_memory(void);
+static void          invalid_free(void *ptr, char *filename, int lineno);
+static unsigned long bucket_of(void *addr, unsigned long nbuckets);
+static void          grow_shard(shard *s);
+static void          make_key(void);
+static void          release_shard(void *arg);
+static shard        *my_shard(void);
+static int           is_shard(shard *s);
+static void          drain_remote(shard *s);
+static void         *track(void *mem, size_t nbytes,
+                           char *filename, int lineno);
+static int           by_place(const void *a, const void *b);
+
 
 /*
- * Initialize the memory pool linked list as a global variable.
+ * The list of all shards.  Shards are only ever added to it (at the
+ * front, under 'shards_lock'), so it can be walked without the lock.
  */
 
-mem_node *pool = NULL;
+static shard *shards = NULL;
+static pthread_mutex_t shards_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Each thread's shard, once it has one. */
+static pthread_key_t  shard_key;
+static pthread_once_t shard_key_once = PTHREAD_ONCE_INIT;
 
 
 /**********************************************************************
  *
- * Low-level functions for managing the memory pool linked list.
+ * Low-level functions for managing the shards.
  *
  **********************************************************************/
 
+static void
+out_of_memory(void)
+{
+    fprintf(stderr, "ERROR: memory allocation failed!  Aborting...\n");
+    exit(1);
+}
+
+
+static void
+invalid_free(void *ptr, char *filename, int lineno)
+{
+    fprintf(stderr,
+            "ERROR: invalid attempt to free unallocated memory at %p "
+            "in file: %s, line: %d\n", ptr, filename, lineno);
+    fprintf(stderr, "Aborting...\n");
+    exit(1);
+}
+
+
 /*
- * Allocate a memory node, set its values and link it into the memory
- * pool linked list.
+ * The bucket of an address.  The low bits are the same for every
+ * address malloc returns, so they are shifted out, and higher bits
+ * are folded in so that blocks a bucket count apart don't collide.
+ */
+
+static unsigned long
+bucket_of(void *addr, unsigned long nbuckets)
+{
+    unsigned long a;
+
+    a = (unsigned long)addr >> 4;
+    return (a ^ (a >> 10) ^ (a >> 20)) & (nbuckets - 1);
+}
+
+
+/*
+ * Double the number of buckets of a shard (or make the first ones),
+ * moving the nodes over to the new buckets.
+ */
+
+static void
+grow_shard(shard *s)
+{
+    mem_node **buckets, *n, *next;
+    unsigned long nbuckets, i, b;
+
+    nbuckets = s->nbuckets == 0 ? MIN_BUCKETS : 2 * s->nbuckets;
+    buckets  = (mem_node **)calloc(nbuckets, sizeof(mem_node *));
+
+    if (buckets == NULL)
+    {
+        out_of_memory();
+    }
+
+    for (i = 0; i < s->nbuckets; i++)
+    {
+        for (n = s->buckets[i]; n != NULL; n = next)
+        {
+            next       = n->next;
+            b          = bucket_of(n->addr, nbuckets);
+            n->next    = buckets[b];
+            buckets[b] = n;
+        }
+    }
+
+    if (s->buckets != NULL)
+    {
+        free(s->buckets);
+    }
+
+    s->buckets  = buckets;
+    s->nbuckets = nbuckets;
+}
+
+
+static void
+make_key(void)
+{
+    if (pthread_key_create(&shard_key, release_shard) != 0)
+    {
+        out_of_memory();
+    }
+}
+
+
+/* Called as a thread exits: its shard is free for another thread. */
+
+static void
+release_shard(void *arg)
+{
+    STORE(&((shard *)arg)->in_use, 0);
+}
+
+
+/*
+ * Return the calling thread's shard.  A thread's first call takes
+ * over the shard of a thread that has exited, or adds a new one.
+ */
+
+static shard *
+my_shard(void)
+{
+    shard *s;
+
+    pthread_once(&shard_key_once, make_key);
+    s = (shard *)pthread_getspecific(shard_key);
+
+    if (s != NULL)
+    {
+        return s;
+    }
+
+    for (s = LOAD(&shards); s != NULL; s = s->next)
+    {
+        if (LOAD(&s->in_use) == 0
+            && __sync_bool_compare_and_swap(&s->in_use, 0, 1))
+        {
+            break;
+        }
+    }
+
+    if (s == NULL)
+    {
+        s = (shard *)calloc(1, sizeof(shard));
+
+        if (s == NULL)
+        {
+            out_of_memory();
+        }
+
+        s->in_use = 1;
+        pthread_mutex_lock(&shards_lock);
+        s->next = shards;
+        STORE(&shards, s);
+        pthread_mutex_unlock(&shards_lock);
+    }
+
+    pthread_setspecific(shard_key, s);
+    return s;
+}
+
+
+/* Is 's' one of the shards? */
+
+static int
+is_shard(shard *s)
+{
+    shard *t;
+
+    for (t = LOAD(&shards); t != NULL; t = t->next)
+    {
+        if (t == s)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+/*
+ * Really free the memory other threads have handed back to shard 's'.
+ * Only the thread using the shard may call this.
+ */
+
+static void
+drain_remote(shard *s)
+{
+    mem_header *h, *next;
+    mem_node **link;
+
+    if (LOAD(&s->remote) == NULL)
+    {
+        return;
+    }
+
+    h = __atomic_exchange_n(&s->remote, NULL, __ATOMIC_ACQUIRE);
+
+    for ( ; h != NULL; h = next)
+    {
+        next = h->h.next;
+        link = find_link(s, MEMORY_OF(h));
+
+        if (link == NULL)
+        {
+            invalid_free(MEMORY_OF(h), "(another thread)", 0);
+        }
+
+        free_mem_node(s, link);
+    }
+}
+
+
+/*
+ * Take a memory node from the shard's free list (allocating a new
+ * block of them if it is empty), set its values and add it to the
+ * shard's table.
  */
 
 void
-allocate_mem_node(void *addr, size_t nbytes, char *filename, int lineno)
+allocate_mem_node(shard *s, void *addr, size_t nbytes,
+                  char *filename, int lineno)
 {
     mem_node *n;
-    char *fn;
+    node_block *nb;
+    unsigned long b;
+    int i;
+
+    if (s->free_nodes == NULL)
+    {
+        nb = (node_block *)malloc(sizeof(node_block));
 
-    /* Create the node and set its fields. */
-    n = (mem_node *)malloc(sizeof(mem_node));
+        if (nb == NULL)
+        {
+            out_of_memory();
+        }
 
-    if (n == NULL)
+        for (i = NODE_BLOCK - 1; i >= 0; i--)
+        {
+            nb->nodes[i].next = s->free_nodes;
+            s->free_nodes = &nb->nodes[i];
+        }
+
+        nb->next  = s->blocks;
+        s->blocks = nb;
+    }
+
+    if (s->count >= s->nbuckets)
     {
-        fprintf(stderr, "ERROR: memory allocation failed!  Aborting...\n");
-        exit(1);
+        grow_shard(s);
     }
 
 #if DEBUG == 1
     fprintf(stderr, "Allocating %d bytes of memory at %p\n",
-            nbytes, addr);
+            (int)nbytes, addr);
 #endif
 
-    /* Copy the filename, which is statically allocated (I think). */
-    fn = (char *)malloc((strlen(filename) + 1) * sizeof(char));
-    strcpy(fn, filename);
+    n = s->free_nodes;
+    s->free_nodes = n->next;
 
+    /*
+     * The filename is __FILE__, a string literal that lasts as long
+     * as the program, so the node just points to it.
+     */
     n->addr     = addr;
     n->nbytes   = nbytes;
-    n->filename = fn;
+    n->filename = filename;
     n->lineno   = lineno;
 
-    /* Add it to the front of the memory pool. */
-    n->next = pool;
-    pool    = n;
+    b             = bucket_of(addr, s->nbuckets);
+    n->next       = s->buckets[b];
+    s->buckets[b] = n;
+    s->count++;
 }
 
 
 /*
- * Free a memory node from the pool.
+ * Free the memory of the node at '*link', take the node out of its
+ * bucket and put it on the shard's free list.
  */
 
 void
-free_mem_node(mem_node *n)
+free_mem_node(shard *s, mem_node **link)
 {
-    if (n != NULL)
-    {
-        if (n->addr == NULL)
-        {
-            fprintf(stderr, "ERROR: invalid node at: %p\n", n->addr);
-            return;
-        }
+    mem_node *n;
+
+    n = *link;
 
 #if DEBUG == 1
-        fprintf(stderr, "Freeing memory at %p\n", n->addr);
+    fprintf(stderr, "Freeing memory at %p\n", n->addr);
 #endif
 
-        free(n->addr);
-        free(n->filename);
-        free(n);
-    }
+    /* a stale pointer to it is then no longer taken for live memory */
+    HEADER_OF(n->addr)->h.state = 0;
+    free(HEADER_OF(n->addr));
+
+    *link         = n->next;
+    n->next       = s->free_nodes;
+    s->free_nodes = n;
+    s->count--;
 }
 
 
 /*
- * Free a memory node from the pool.  Adjust the 'next' pointer of the
- * previous node (if any) to skip over this node.
+ * Free all the memory of a shard, and its table.  The shard itself
+ * stays, empty, since a thread may still be using it.
  */
 
 void
-free_mem_node_and_adjust_pool(mem_node *n)
+free_all_mem_nodes(shard *s)
 {
-    mem_node *p, *prev;
+    unsigned long i;
+    node_block *nb;
 
-    prev = NULL;
+    drain_remote(s);
 
-    for (p = pool; p != NULL; p = p->next)
+    for (i = 0; i < s->nbuckets; i++)
     {
-        if (p->addr == n->addr)
-        {
-            if (prev == NULL)
-            {
-                /* The node to be removed is the first node. */
-                pool = p->next;
-                free_mem_node(p);
-                break;   /* Nothing left to do. */
-            }
-            else
-            {
-                /*
-                 * The node is in the interior of the memory pool
-                 * linked list.  Adjust the 'next' pointer of the
-                 * previous node and free the node.
-                 */
-                prev->next = p->next;
-                free_mem_node(p);
-                break;   /* Nothing left to do. */
-            }
-        }
-        else
+        while (s->buckets[i] != NULL)
         {
-            prev = p;
+            free_mem_node(s, &s->buckets[i]);
         }
     }
+
+    while (s->blocks != NULL)
+    {
+        nb        = s->blocks;
+        s->blocks = nb->next;
+        free(nb);
+    }
+
+    if (s->buckets != NULL)
+    {
+        free(s->buckets);
+    }
+
+    s->buckets    = NULL;
+    s->nbuckets   = 0;
+    s->free_nodes = NULL;
 }
 
 
 /*
- * Free all the memory nodes from the pool.
+ * Return the link (the bucket, or the 'next' of the node before)
+ * that points to the node for the address 'addr' in shard 's', or
+ * NULL if the address isn't found.
  */
 
-void
-free_all_mem_nodes(void)
+mem_node **
+find_link(shard *s, void *addr)
 {
-    mem_node *n, *next;
+    mem_node **link;
 
-    n = pool;
+    if (s->count == 0)
+    {
+        return NULL;
+    }
 
-    while (n != NULL)
+    for (link = &s->buckets[bucket_of(addr, s->nbuckets)];
+         *link != NULL; link = &(*link)->next)
     {
-        next = n->next;
-        free_mem_node(n);
-        n = next;
+        if ((*link)->addr == addr)
+        {
+            return link;
+        }
     }
+
+    return NULL;
 }
 
 
 /*
- * Return the node that corresponds to the address 'addr', or NULL if
- * the address isn't found.
+ * A debugging function to print the contents of the shards.  Other
+ * threads must not be allocating or freeing meanwhile.
  */
 
-mem_node *
-find_node(void *addr)
+void
+dump_pool(void)
 {
+    shard *s;
     mem_node *n;
+    unsigned long i;
 
-    for (n = pool; n != NULL; n = n->next)
+    for (s = LOAD(&shards); s != NULL; s = s->next)
     {
-        if (n->addr == addr)
+        for (i = 0; i < s->nbuckets; i++)
         {
-            return n;
+            for (n = s->buckets[i]; n != NULL; n = n->next)
+            {
+                fprintf(stderr, "NODE --------\n");
+                fprintf(stderr, "location: %p\n", (void *)n);
+                fprintf(stderr, "shard: %p\n", (void *)s);
+                fprintf(stderr, "bucket: %lu\n", i);
+                fprintf(stderr, "addr: %p\n", n->addr);
+                fprintf(stderr, "nbytes: %d\n", (int)n->nbytes);
+                fprintf(stderr, "filename: %s\n", n->filename);
+                fprintf(stderr, "line number: %d\n", n->lineno);
+                fprintf(stderr, "next: %p\n", (void *)n->next);
+                fprintf(stderr, "\n");
+            }
         }
     }
-
-    return NULL;
 }
 
 
 /*
- * A debugging function to print the contents of the memory pool
- * linked list.
+ * Set up the header of the new memory 'mem' and add it to the
+ * calling thread's shard, returning the memory for the user.
  */
 
-void
-dump_pool(void)
+static void *
+track(void *mem, size_t nbytes, char *filename, int lineno)
 {
-    mem_node *n;
+    mem_header *h;
+    shard *s;
+
+    if (mem == NULL)
+    {
+        out_of_memory();
+    }
+
+    s = my_shard();
+    drain_remote(s);
+
+    h = (mem_header *)mem;
+    h->h.owner = s;
+    h->h.next  = NULL;
+    h->h.state = HEADER_LIVE;
 
-    for (n = pool; n != NULL; n = n->next)
+    allocate_mem_node(s, MEMORY_OF(h), nbytes, filename, lineno);
+    return MEMORY_OF(h);
+}
+
+
+/* Order leaks by where they were allocated, then by address. */
+
+static int
+by_place(const void *a, const void *b)
+{
+    mem_node *m, *n;
+    int c;
+
+    m = *(mem_node **)a;
+    n = *(mem_node **)b;
+    c = strcmp(m->filename, n->filename);
+
+    if (c != 0)
+    {
+        return c;
+    }
+
+    if (m->lineno != n->lineno)
     {
-        fprintf(stderr, "NODE --------\n");
-        fprintf(stderr, "location: %p\n", (void *)n);
-        fprintf(stderr, "addr: %p\n", n->addr);
-        fprintf(stderr, "nbytes: %d\n", (int)n->nbytes);
-        fprintf(stderr, "filename: %s\n", n->filename);
-        fprintf(stderr, "line number: %d\n", n->lineno);
-        fprintf(stderr, "next: %p\n", (void *)n->next);
-        fprintf(stderr, "\n");
+        return m->lineno < n->lineno ? -1 : 1;
     }
+
+    return m->addr < n->addr ? -1 : m->addr > n->addr;
 }
 
 
@@ -248,24 +618,18 @@ dump_pool(void)
 
 /*
  * Allocate 'size' bytes of memory.  Also add the address, filename, and line
- * number as a new node in the memory pool linked list.
+ * number as a new node in the calling thread's shard.
  */
 
 void *
 checked_malloc_fn(size_t size, char *filename, int lineno)
 {
-    void *mem;
-
-    mem = malloc(size);
-
-    if (mem == NULL)
+    if (size > (size_t)-1 - sizeof(mem_header))
     {
-        fprintf(stderr, "ERROR: memory allocation failed!  Aborting...\n");
-        exit(1);
+        out_of_memory();
     }
 
-    allocate_mem_node(mem, size, filename, lineno);
-    return mem;
+    return track(malloc(sizeof(mem_header) + size), size, filename, lineno);
 }
 
 
@@ -278,18 +642,13 @@ checked_malloc_fn(size_t size, char *filename, int lineno)
 void *
 checked_calloc_fn(size_t nmemb, size_t size, char *filename, int lineno)
 {
-    void *mem;
-
-    mem = calloc(nmemb, size);
-
-    if (mem == NULL)
+    if (size != 0 && nmemb > ((size_t)-1 - sizeof(mem_header)) / size)
     {
-        fprintf(stderr, "ERROR: memory allocation failed!  Aborting...\n");
-        exit(1);
+        out_of_memory();
     }
 
-    allocate_mem_node(mem, (nmemb * size), filename, lineno);
-    return mem;
+    return track(calloc(1, sizeof(mem_header) + nmemb * size),
+                 nmemb * size, filename, lineno);
 }
 
 
@@ -297,49 +656,140 @@ checked_calloc_fn(size_t nmemb, size_t size, char *filename, int lineno)
  * Free a pointer that was previously allocated by 'checked_malloc()'.  If
  * the memory being freed is not found in the memory pool, print an error
  * message and abort.
+ *
+ * Memory allocated by the calling thread is found in its own shard
+ * and freed at once, without looking at the header.  Only for other
+ * memory is the header read: it must be marked live and name one of
+ * the shards.  Such memory is marked as handed back and pushed onto
+ * that shard's 'remote' list, and the thread using the shard frees it
+ * the next time it allocates or frees.
  */
 
 void
 checked_free_fn(void *ptr, char *filename, int lineno)
 {
-    mem_node *n = find_node(ptr);
+    mem_header *h, *head;
+    mem_node **link;
+    shard *s, *mine;
 
-    if (n == NULL)
+    if (ptr == NULL)
     {
-        fprintf(stderr,
-                "ERROR: invalid attempt to free unallocated memory at %p "
-                "in file: %s, line: %d\n", ptr, filename, lineno);
-        fprintf(stderr, "Aborting...\n");
-        free_all_mem_nodes();
-        exit(1);
+        invalid_free(ptr, filename, lineno);
     }
-    else
+
+    pthread_once(&shard_key_once, make_key);
+    mine = (shard *)pthread_getspecific(shard_key);
+
+    if (mine != NULL)
+    {
+        drain_remote(mine);
+        link = find_link(mine, ptr);
+
+        if (link != NULL)
+        {
+            free_mem_node(mine, link);
+            return;
+        }
+    }
+
+    /*
+     * Not the calling thread's, so it must be another thread's: the
+     * header has to be marked live and name a shard other than ours.
+     * Then hand it back, once.
+     */
+    h = HEADER_OF(ptr);
+
+    if (LOAD(&h->h.state) != HEADER_LIVE)
+    {
+        invalid_free(ptr, filename, lineno);
+    }
+
+    s = h->h.owner;
+
+    if (s == mine || !is_shard(s)
+        || !__sync_bool_compare_and_swap(&h->h.state, HEADER_LIVE,
+                                         HEADER_HANDED))
     {
-        free_mem_node_and_adjust_pool(n);
+        invalid_free(ptr, filename, lineno);
     }
+
+    do
+    {
+        head = LOAD(&s->remote);
+        h->h.next = head;
+    } while (!__sync_bool_compare_and_swap(&s->remote, head, h));
 }
 
 
 /*
- * This function is intended to be called at the end of a program only.
- * It goes through the memory pool node-by-node and prints out information
- * on the contents of the node.  Any nodes that exist at the end of the
- * program represent leaked memory.
+ * This function is intended to be called at the end of a program only,
+ * when the other threads are done.  It merges the shards' allocations
+ * and prints out information on each, in order of where it was
+ * allocated.  Any allocations that exist at the end of the program
+ * represent leaked memory.
  */
 
 void
 print_memory_leaks(void)
 {
-    mem_node *n;
+    shard *s;
+    mem_node *n, **leaks;
+    unsigned long i, nleaks;
 
-    for (n = pool; n != NULL; n = n->next)
+    pthread_mutex_lock(&shards_lock);
+    nleaks = 0;
+
+    for (s = shards; s != NULL; s = s->next)
     {
-        fprintf(stderr,
-                "Memory leak: %d bytes allocated at %p in "
-                "file: %s, line: %d.\n",
-                (int)n->nbytes, n->addr, n->filename, n->lineno);
+        drain_remote(s);
+        nleaks += s->count;
     }
 
-    free_all_mem_nodes();
-}
+    leaks = NULL;
+
+    if (nleaks > 0)
+    {
+        leaks = (mem_node **)malloc(nleaks * sizeof(mem_node *));
 
+        if (leaks == NULL)
+        {
+            out_of_memory();
+        }
+    }
+
+    nleaks = 0;
+
+    for (s = shards; s != NULL; s = s->next)
+    {
+        for (i = 0; i < s->nbuckets; i++)
+        {
+            for (n = s->buckets[i]; n != NULL; n = n->next)
+            {
+                leaks[nleaks++] = n;
+            }
+        }
+    }
+
+    if (leaks != NULL)
+    {
+        qsort(leaks, nleaks, sizeof(mem_node *), by_place);
+
+        for (i = 0; i < nleaks; i++)
+        {
+            n = leaks[i];
+            fprintf(stderr,
+                    "Memory leak: %d bytes allocated at %p in "
+                    "file: %s, line: %d.\n",
+                    (int)n->nbytes, n->addr, n->filename, n->lineno);
+        }
+
+        free(leaks);
+    }
+
+    for (s = shards; s != NULL; s = s->next)
+    {
+        free_all_mem_nodes(s);
+    }
+
+    pthread_mutex_unlock(&shards_lock);
+}
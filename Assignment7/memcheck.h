@@ -14,21 +14,31 @@ void *checked_malloc_fn(size_t size, char *filename, int lineno);
 void *checked_calloc_fn(size_t nmemb, size_t size,
                         char *filename, int lineno);
 void  checked_free_fn(void *ptr, char *filename, int lineno);
+
+/*
+ * The checked functions may be called from any number of threads at
+ * once; each thread keeps its own records, and memory may be freed by
+ * another thread than the one that allocated it.  print_memory_leaks
+ * reports the leaks of all the threads, by file and line, and should
+ * only be called once the other threads are done.
+ */
 void  print_memory_leaks(void);
 
 /*
  * Macros which maintain the interface of the standard malloc/calloc/free
  * functions.  Don't include these if this file is being included into
  * memcheck.c, or it will screw up the definitions of the checked functions.
+ * Building with -DNO_MEMCHECK leaves the standard functions alone, for
+ * benchmarks that shouldn't pay for the checking.
  */
 
-#ifndef MEMCHECK_C
+#if !defined(MEMCHECK_C) && !defined(NO_MEMCHECK)
 
 #define malloc(n)    checked_malloc_fn((n), __FILE__, __LINE__)
 #define calloc(n, m) checked_calloc_fn((n), (m), __FILE__, __LINE__)
 #define free(p)      checked_free_fn((p), __FILE__, __LINE__)
 
-#endif  /* MEMCHECK_C */
+#endif  /* MEMCHECK_C, NO_MEMCHECK */
 
 #endif  /* MEMCHECK_H */
 
@@ -0,0 +1,233 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: parallel.c
+ *
+ *       Multi-threaded word counting with per-thread tables and a
+ *       merge by hash partition.
+ *
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+#include "parallel.h"
+#include "tokenizer.h"
+#include "memcheck.h"
+
+/*
+ * The partition a key belongs to.  It comes from the high half of the
+ * hash: the low bits pick the slot, and a partition whose keys all
+ * shared them would use only a fraction of its slots.
+ */
+#define HALF_BITS (sizeof(unsigned long) * CHAR_BIT / 2)
+#define PARTITION(h, n) ((int) (((h) >> HALF_BITS) % (unsigned long) (n)))
+
+/* A key and its count from one thread's table. */
+
+typedef struct
+{
+    char *key;
+    int value;
+} record;
+
+typedef struct _worker
+{
+    int id;
+    int nthreads;
+    unsigned long seed;
+    char *start;                /* this thread's chunk of the input  */
+    char *end;
+    hash_table *ht;             /* its counts                        */
+    record *records;            /* its keys, grouped by partition    */
+    size_t first[MAX_THREADS + 1]; /* partition p is records
+                                      [first[p], first[p + 1])       */
+    size_t next[MAX_THREADS];   /* where the next record of each
+                                   partition goes, while filling     */
+    hash_table *part;           /* partition 'id' of the result      */
+    struct _worker *all;        /* every thread's worker             */
+} worker;
+
+static void *count_chunk(void *arg);
+static void *merge_partition(void *arg);
+static void count_partition(char *key, int value, unsigned long hash,
+                            void *arg);
+static void place_record(char *key, int value, unsigned long hash,
+                         void *arg);
+static void run_threads(worker *w, int nthreads, void *(*fn)(void *));
+
+
+/*** Counting. ***/
+
+/* Count one chunk, then sort its keys into partitions. */
+static void *count_chunk(void *arg)
+{
+    worker *w;
+    tokenizer t;
+    char *word;
+    size_t len;
+    int p;
+
+    w = (worker *) arg;
+    w->ht = create_hash_table_seeded(w->seed);
+
+    init_tokenizer(&t, w->start, w->end - w->start);
+    while (next_word(&t, &word, &len))
+    {
+        increment_value_n(w->ht, word, len);
+    }
+
+    /* Count the keys of each partition, then copy them into place. */
+    memset(w->first, 0, sizeof(w->first));
+    foreach_entry(w->ht, count_partition, w);
+
+    for (p = 0; p < w->nthreads; p++)
+    {
+        w->first[p + 1] += w->first[p];
+        w->next[p] = w->first[p];
+    }
+
+    w->records = (record *) malloc((w->first[w->nthreads] + 1)
+                                   * sizeof(record));
+    if (w->records == NULL)
+    {
+        fprintf(stderr, "Error: memory allocation failed! "
+                        "Terminating program.\n");
+        exit(1);
+    }
+
+    foreach_entry(w->ht, place_record, w);
+    return NULL;
+}
+
+
+/* Leaves the size of partition p in first[p + 1]. */
+static void count_partition(char *key, int value, unsigned long hash,
+                            void *arg)
+{
+    worker *w;
+    w = (worker *) arg;
+    w->first[PARTITION(hash, w->nthreads) + 1]++;
+}
+
+
+static void place_record(char *key, int value, unsigned long hash,
+                         void *arg)
+{
+    worker *w;
+    record *r;
+    w = (worker *) arg;
+    r = &w->records[w->next[PARTITION(hash, w->nthreads)]++];
+    r->key = key;
+    r->value = value;
+}
+
+
+/*** Merging. ***/
+
+/* Add up partition 'id' over every thread's table. */
+static void *merge_partition(void *arg)
+{
+    worker *w, *from;
+    record *r;
+    size_t i;
+    int t;
+
+    w = (worker *) arg;
+    w->part = create_hash_table_seeded(w->seed);
+
+    for (t = 0; t < w->nthreads; t++)
+    {
+        from = &w->all[t];
+        for (i = from->first[w->id]; i < from->first[w->id + 1]; i++)
+        {
+            r = &from->records[i];
+            *find_or_insert_copy(w->part, r->key) += r->value;
+        }
+    }
+
+    return NULL;
+}
+
+
+/*** Driver. ***/
+
+/* Run 'fn' on each worker in a thread of its own and wait for them. */
+static void run_threads(worker *w, int nthreads, void *(*fn)(void *))
+{
+    pthread_t tid[MAX_THREADS];
+    int i;
+
+    for (i = 0; i < nthreads; i++)
+    {
+        if (pthread_create(&tid[i], NULL, fn, &w[i]) != 0)
+        {
+            fprintf(stderr, "Error: can't create a thread! "
+                            "Terminating program.\n");
+            exit(1);
+        }
+    }
+
+    for (i = 0; i < nthreads; i++)
+    {
+        pthread_join(tid[i], NULL);
+    }
+}
+
+
+void count_words_parallel(char *data, size_t size, int nthreads,
+                          hash_table **parts)
+{
+    worker *w;
+    unsigned long seed;
+    size_t cut;
+    int i;
+
+    w = (worker *) malloc(nthreads * sizeof(worker));
+    if (w == NULL)
+    {
+        fprintf(stderr, "Error: memory allocation failed! "
+                        "Terminating program.\n");
+        exit(1);
+    }
+
+    /* Every table uses the same seed, so a key has one partition. */
+    seed = hash_seed();
+
+    /* Cut the input into chunks, moving each cut on to whitespace. */
+    for (i = 0; i < nthreads; i++)
+    {
+        w[i].id = i;
+        w[i].nthreads = nthreads;
+        w[i].seed = seed;
+        w[i].all = w;
+        w[i].start = (i == 0) ? data : w[i - 1].end;
+
+        cut = (i == nthreads - 1) ? size : size / nthreads * (i + 1);
+        if (data + cut < w[i].start)
+        {
+            cut = w[i].start - data;
+        }
+        while (cut < size && !IS_SPACE(data[cut]))
+        {
+            cut++;
+        }
+        w[i].end = data + cut;
+    }
+
+    run_threads(w, nthreads, count_chunk);
+    run_threads(w, nthreads, merge_partition);
+
+    for (i = 0; i < nthreads; i++)
+    {
+        parts[i] = w[i].part;
+        free(w[i].records);
+        free_hash_table(w[i].ht);
+    }
+
+    free(w);
+}
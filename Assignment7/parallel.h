@@ -0,0 +1,33 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: parallel.h
+ *
+ *       Counting words with several threads.
+ *
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stddef.h>
+#include "hash_table.h"
+
+#define MAX_THREADS 256
+
+/*
+ * Count the words in the 'size' bytes at 'data' with 'nthreads'
+ * threads.
+ *
+ * The input is cut at whitespace into one chunk per thread, and each
+ * thread counts its chunk into a table of its own.  The tables are
+ * then merged in parallel: each thread takes one partition of the
+ * keys (by hash) and adds up that partition's counts from every
+ * thread's table.  The result is 'nthreads' tables with no keys in
+ * common, stored in 'parts'; together they hold the same counts a
+ * single table would.
+ */
+void count_words_parallel(char *data, size_t size, int nthreads,
+                          hash_table **parts);
+
+#endif  /* PARALLEL_H */
@@ -0,0 +1,451 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: report.c
+ *
+ *       Implementation of the sorted and top-K listings.
+ *
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "report.h"
+#include "memcheck.h"
+
+#define MAX_SORT_THREADS 64
+
+typedef int (*count_cmp)(const void *, const void *);
+
+/* One thread's share of a sort: a run to sort, or two to merge. */
+typedef struct
+{
+    count_entry *src;
+    count_entry *dst;
+    size_t lo, mid, hi;     /* runs [lo, mid) and [mid, hi) */
+    count_cmp cmp;
+} sort_job;
+
+typedef struct
+{
+    count_entry *e;
+    size_t n;
+} extract_arg;
+
+static void memory_fail(void);
+static void count_pair(char *key, int value, unsigned long hash,
+                       void *arg);
+static void add_count(char *key, int value, unsigned long hash, void *arg);
+static int by_count(const void *a, const void *b);
+static int by_key(const void *a, const void *b);
+static void *sort_run(void *arg);
+static void *merge_runs(void *arg);
+static void run_jobs(sort_job *jobs, int njobs, void *(*fn)(void *));
+static void sift_down(count_entry *heap, size_t n, size_t i);
+
+
+static void memory_fail(void)
+{
+    fprintf(stderr, "Error: memory allocation failed! "
+                    "Terminating program.\n");
+    exit(1);
+}
+
+
+/*** Extracting. ***/
+
+static void count_pair(char *key, int value, unsigned long hash, void *arg)
+{
+    (*(size_t *) arg)++;
+}
+
+
+static void add_count(char *key, int value, unsigned long hash, void *arg)
+{
+    extract_arg *x;
+    x = (extract_arg *) arg;
+    x->e[x->n].key = key;
+    x->e[x->n].count = value;
+    x->n++;
+}
+
+
+count_entry *extract_counts(hash_table **tables, int ntables, size_t *n)
+{
+    extract_arg x;
+    size_t total;
+    int i;
+
+    /* (this file doesn't know which table implementation it has) */
+    total = 0;
+    for (i = 0; i < ntables; i++)
+    {
+        foreach_entry(tables[i], count_pair, &total);
+    }
+
+    x.e = (count_entry *) malloc((total + 1) * sizeof(count_entry));
+    if (x.e == NULL) memory_fail();
+    x.n = 0;
+
+    for (i = 0; i < ntables; i++)
+    {
+        foreach_entry(tables[i], add_count, &x);
+    }
+
+    *n = x.n;
+    return x.e;
+}
+
+
+/*** Sorting. ***/
+
+static int by_count(const void *a, const void *b)
+{
+    const count_entry *x, *y;
+    x = (const count_entry *) a;
+    y = (const count_entry *) b;
+    if (x->count != y->count)
+    {
+        return x->count > y->count ? -1 : 1;
+    }
+    return strcmp(x->key, y->key);
+}
+
+
+static int by_key(const void *a, const void *b)
+{
+    return strcmp(((const count_entry *) a)->key,
+                  ((const count_entry *) b)->key);
+}
+
+
+static void *sort_run(void *arg)
+{
+    sort_job *j;
+    j = (sort_job *) arg;
+    qsort(j->src + j->lo, j->hi - j->lo, sizeof(count_entry), j->cmp);
+    return NULL;
+}
+
+
+/* Merge two sorted runs of 'src' into the same place in 'dst'. */
+static void *merge_runs(void *arg)
+{
+    sort_job *j;
+    size_t a, b, out;
+    j = (sort_job *) arg;
+    a = j->lo;
+    b = j->mid;
+    out = j->lo;
+    while (a < j->mid && b < j->hi)
+    {
+        /* take from the left run unless the right one is smaller */
+        if (j->cmp(&j->src[b], &j->src[a]) < 0)
+        {
+            j->dst[out++] = j->src[b++];
+        }
+        else
+        {
+            j->dst[out++] = j->src[a++];
+        }
+    }
+    while (a < j->mid)
+    {
+        j->dst[out++] = j->src[a++];
+    }
+    while (b < j->hi)
+    {
+        j->dst[out++] = j->src[b++];
+    }
+    return NULL;
+}
+
+
+/* Run each job in a thread of its own (the last one in this thread). */
+static void run_jobs(sort_job *jobs, int njobs, void *(*fn)(void *))
+{
+    pthread_t tid[MAX_SORT_THREADS];
+    int i, nstarted;
+
+    nstarted = 0;
+    for (i = 0; i < njobs - 1; i++)
+    {
+        if (pthread_create(&tid[i], NULL, fn, &jobs[i]) != 0)
+        {
+            break;
+        }
+        nstarted++;
+    }
+
+    /* whatever couldn't get a thread runs here */
+    for (i = nstarted; i < njobs; i++)
+    {
+        fn(&jobs[i]);
+    }
+
+    for (i = 0; i < nstarted; i++)
+    {
+        pthread_join(tid[i], NULL);
+    }
+}
+
+
+void sort_counts(count_entry *e, size_t n, int order, int nthreads)
+{
+    sort_job jobs[MAX_SORT_THREADS];
+    size_t bound[MAX_SORT_THREADS + 1];
+    count_entry *tmp, *src, *dst, *swap;
+    count_cmp cmp;
+    int i, nruns, njobs;
+
+    cmp = (order == BY_KEY) ? by_key : by_count;
+
+    if (nthreads > MAX_SORT_THREADS)
+    {
+        nthreads = MAX_SORT_THREADS;
+    }
+    if (nthreads < 1 || n < 2 * (size_t) nthreads)
+    {
+        nthreads = 1;
+    }
+
+    /* Sort one run per thread. */
+    nruns = nthreads;
+    for (i = 0; i <= nruns; i++)
+    {
+        bound[i] = n / nruns * i;
+    }
+    bound[nruns] = n;
+
+    for (i = 0; i < nruns; i++)
+    {
+        jobs[i].src = e;
+        jobs[i].lo = bound[i];
+        jobs[i].hi = bound[i + 1];
+        jobs[i].cmp = cmp;
+    }
+    run_jobs(jobs, nruns, sort_run);
+
+    if (nruns == 1)
+    {
+        return;
+    }
+
+    /* Merge neighbouring runs, in parallel, until one is left. */
+    tmp = (count_entry *) malloc(n * sizeof(count_entry));
+    if (tmp == NULL) memory_fail();
+    src = e;
+    dst = tmp;
+
+    while (nruns > 1)
+    {
+        njobs = 0;
+        for (i = 0; i < nruns; i += 2)
+        {
+            jobs[njobs].src = src;
+            jobs[njobs].dst = dst;
+            jobs[njobs].lo = bound[i];
+            jobs[njobs].mid = bound[i + 1];
+            jobs[njobs].hi = (i + 1 < nruns) ? bound[i + 2] : bound[i + 1];
+            jobs[njobs].cmp = cmp;
+            njobs++;
+        }
+        run_jobs(jobs, njobs, merge_runs);
+
+        /* the merged runs' bounds are every other old bound */
+        for (i = 0; i < njobs; i++)
+        {
+            bound[i] = jobs[i].lo;
+        }
+        bound[njobs] = n;
+        nruns = njobs;
+
+        swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    if (src != e)
+    {
+        memcpy(e, src, n * sizeof(count_entry));
+    }
+    free(tmp);
+}
+
+
+/*** Top K. ***/
+
+/*
+ * Restore the heap below index 'i'.  The heap keeps the worst of the
+ * entries kept so far (in by_count order) at the root.
+ */
+static void sift_down(count_entry *heap, size_t n, size_t i)
+{
+    size_t child;
+    count_entry t;
+    while ((child = 2 * i + 1) < n)
+    {
+        if (child + 1 < n && by_count(&heap[child + 1], &heap[child]) > 0)
+        {
+            child++;
+        }
+        if (by_count(&heap[child], &heap[i]) <= 0)
+        {
+            break;
+        }
+        t = heap[i];
+        heap[i] = heap[child];
+        heap[child] = t;
+        i = child;
+    }
+}
+
+
+size_t top_counts(count_entry *e, size_t n, size_t k)
+{
+    size_t i;
+    count_entry t;
+
+    if (k > n)
+    {
+        k = n;
+    }
+    if (k == 0)
+    {
+        return 0;
+    }
+
+    /* The first k entries make the heap... */
+    for (i = k / 2; i-- > 0; )
+    {
+        sift_down(e, k, i);
+    }
+
+    /* ...and any later entry better than its worst replaces it. */
+    for (i = k; i < n; i++)
+    {
+        if (by_count(&e[i], &e[0]) < 0)
+        {
+            t = e[0];
+            e[0] = e[i];
+            e[i] = t;
+            sift_down(e, k, 0);
+        }
+    }
+
+    qsort(e, k, sizeof(count_entry), by_count);
+    return k;
+}
+
+
+void print_counts(count_entry *e, size_t n)
+{
+    size_t i;
+    for (i = 0; i < n; i++)
+    {
+        printf("%s %d\n", e[i].key, e[i].count);
+    }
+}
+
+
+/*
+ * Merge the ranges of the tables: they have no keys in common, so at
+ * each step the least of their current keys is printed and that
+ * table's range moves on.
+ */
+void print_range(hash_table **tables, int ntables, char *lo, char *hi)
+{
+    key_range *r;
+    count_entry *cur;
+    int i, least;
+
+    r = (key_range *) malloc(ntables * sizeof(key_range));
+    cur = (count_entry *) malloc(ntables * sizeof(count_entry));
+    if (r == NULL || cur == NULL) memory_fail();
+
+    for (i = 0; i < ntables; i++)
+    {
+        find_range(tables[i], lo, hi, &r[i]);
+        if (!next_in_range(&r[i], &cur[i].key, &cur[i].count))
+        {
+            cur[i].key = NULL;
+        }
+    }
+
+    for ( ; ; )
+    {
+        least = -1;
+        for (i = 0; i < ntables; i++)
+        {
+            if (cur[i].key != NULL)
+            {
+                if (least < 0 || strcmp(cur[i].key, cur[least].key) < 0)
+                {
+                    least = i;
+                }
+            }
+        }
+        if (least < 0)
+        {
+            break;
+        }
+
+        printf("%s %d\n", cur[least].key, cur[least].count);
+        if (!next_in_range(&r[least], &cur[least].key, &cur[least].count))
+        {
+            cur[least].key = NULL;
+        }
+    }
+
+    free(r);
+    free(cur);
+}
+
+
+void print_table_stats(FILE *fp, table_stats *s)
+{
+    unsigned long total;
+    int i;
+
+    fprintf(fp, "%s table: %lu keys in %lu slots, load %.2f\n",
+            s->kind, s->count, s->nslots, s->load);
+
+    total = 0;
+    for (i = 0; i <= STATS_HIST; i++)
+    {
+        total += s->hist[i];
+    }
+
+    fprintf(fp, "  %-20s %12s   (%% of %lu)\n",
+            s->hist_label, s->hist_unit, total);
+    for (i = 0; i <= STATS_HIST; i++)
+    {
+        fprintf(fp, "  %5d%-15s %12lu   %6.2f\n", i,
+                i == STATS_HIST ? "+" : "", s->hist[i],
+                total == 0 ? 0.0 : 100.0 * s->hist[i] / total);
+    }
+
+    fprintf(fp, "  longest probe %lu, %.2f keys compared per lookup\n",
+            s->longest, s->compares);
+    fprintf(fp, "  %lu bytes in use (%.1f per key)\n",
+            (unsigned long) s->bytes,
+            s->count == 0 ? 0.0 : (double) s->bytes / s->count);
+
+    if (s->filter_fp >= 0.0)
+    {
+        fprintf(fp, "  Bloom filter: %.2f%% false positives\n",
+                100.0 * s->filter_fp);
+    }
+
+    if (s->counted)
+    {
+        fprintf(fp, "  %lu lookups, %lu inserts, %lu resizes, "
+                    "%.2f keys compared per lookup\n",
+                s->ops.lookups, s->ops.inserts, s->ops.resizes,
+                s->ops.lookups == 0
+                ? 0.0 : (double) s->ops.compares / s->ops.lookups);
+    }
+}
@@ -0,0 +1,62 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: report.h
+ *
+ *       Sorted, top-K and range listings of word counts.
+ *
+ */
+
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "hash_table.h"
+
+/* Orders for the listings. */
+#define BY_COUNT 0      /* highest count first, ties by key */
+#define BY_KEY   1      /* by key, in strcmp order          */
+
+typedef struct
+{
+    char *key;          /* points into the table it came from */
+    int count;
+} count_entry;
+
+/*
+ * Copy the pairs of 'ntables' tables into a new array, whose length
+ * goes in '*n'.  The keys aren't copied, so the tables have to
+ * outlive the array.
+ */
+count_entry *extract_counts(hash_table **tables, int ntables, size_t *n);
+
+/*
+ * Sort the array with a merge sort on 'nthreads' threads: each thread
+ * sorts a run of its own, then pairs of runs are merged, in parallel,
+ * until one is left.
+ */
+void sort_counts(count_entry *e, size_t n, int order, int nthreads);
+
+/*
+ * Move the 'k' highest counts to the front of the array, in order,
+ * using a heap of k entries (O(n log k)).  Returns how many there
+ * are (less than 'k' if the array is shorter).
+ */
+size_t top_counts(count_entry *e, size_t n, size_t k);
+
+/* Print the pairs as "key count" lines. */
+void print_counts(count_entry *e, size_t n);
+
+/*
+ * Print the pairs of 'ntables' tables with no keys in common whose
+ * keys are from 'lo' up to but not including 'hi' (NULL for no
+ * bound), in strcmp order.  This uses the tables' ordered indexes,
+ * adding them if need be, so only the keys in the range are visited.
+ */
+void print_range(hash_table **tables, int ntables, char *lo, char *hi);
+
+/* Print the statistics of a table (see hash_table_stats). */
+void print_table_stats(FILE *fp, table_stats *s);
+
+#endif  /* REPORT_H */
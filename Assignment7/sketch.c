@@ -0,0 +1,113 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: sketch.c
+ *
+ *       Implementation of the count-min sketch.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include "sketch.h"
+#include "memcheck.h"
+
+#define ULONG_BITS ((int) (sizeof(unsigned long) * CHAR_BIT))
+
+/*
+ * The counter of row 'i' for a hash: the top bits of the hash times
+ * the row's own odd multiplier.  (Double hashing, as in the Bloom
+ * filter, won't do here: two keys that agree in the first row's and
+ * the step's low bits then collide in every row, which happens often
+ * enough to give a rare word the count of a frequent one.)
+ */
+#if ULONG_MAX > 0xffffffffUL
+static const unsigned long row_mult[SKETCH_DEPTH] =
+{
+    0x9e3779b97f4a7c15UL, 0xbf58476d1ce4e5b9UL,
+    0x94d049bb133111ebUL, 0xd6e8feb86659fd93UL
+};
+#else
+static const unsigned long row_mult[SKETCH_DEPTH] =
+{
+    0x9e3779b9UL, 0x85ebca6bUL, 0xc2b2ae35UL, 0x27d4eb2fUL
+};
+#endif
+
+#define COUNTER(cm, h, i) \
+    ((cm)->count + (i) * (cm)->width + (((h) * row_mult[i]) >> (cm)->shift))
+
+
+void sketch_init(count_min_sketch *cm, unsigned long width)
+{
+    cm->width = 2;
+    cm->shift = ULONG_BITS - 1;
+    while (cm->width < width)
+    {
+        cm->width *= 2;
+        cm->shift--;
+    }
+    cm->total = 0;
+    cm->count = (unsigned long *) calloc(SKETCH_DEPTH * cm->width,
+                                         sizeof(unsigned long));
+    if (cm->count == NULL)
+    {
+        printf("Failed to allocate memory; exiting\n");
+        exit(1);
+    }
+}
+
+
+void sketch_free(count_min_sketch *cm)
+{
+    free(cm->count);
+    cm->count = NULL;
+}
+
+
+unsigned long sketch_add(count_min_sketch *cm, unsigned long hash)
+{
+    unsigned long *c[SKETCH_DEPTH];
+    unsigned long least;
+    int i;
+
+    cm->total++;
+    least = ULONG_MAX;
+    for (i = 0; i < SKETCH_DEPTH; i++)
+    {
+        c[i] = COUNTER(cm, hash, i);
+        if (*c[i] < least)
+        {
+            least = *c[i];
+        }
+    }
+
+    /* only the counters at the least value need to go up */
+    for (i = 0; i < SKETCH_DEPTH; i++)
+    {
+        if (*c[i] == least)
+        {
+            (*c[i])++;
+        }
+    }
+    return least + 1;
+}
+
+
+unsigned long sketch_estimate(count_min_sketch *cm, unsigned long hash)
+{
+    unsigned long least, *c;
+    int i;
+
+    least = ULONG_MAX;
+    for (i = 0; i < SKETCH_DEPTH; i++)
+    {
+        c = COUNTER(cm, hash, i);
+        if (*c < least)
+        {
+            least = *c;
+        }
+    }
+    return least;
+}
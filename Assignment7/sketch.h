@@ -0,0 +1,43 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: sketch.h
+ *
+ *       A count-min sketch: approximate counts of any number of keys
+ *       in a fixed amount of memory.
+ *
+ */
+
+#ifndef SKETCH_H
+#define SKETCH_H
+
+/*
+ * SKETCH_DEPTH rows of 'width' counters.  A key's hash picks one
+ * counter in each row, and its count is the least of them: never too
+ * low, and too high by at most a couple of times (total / width) with
+ * high probability.  Adding a key only raises the counters that are
+ * at that least value ("conservative update"), which keeps the
+ * overcounts down further.
+ */
+#define SKETCH_DEPTH 4
+
+typedef struct
+{
+    unsigned long *count;       /* SKETCH_DEPTH rows of 'width'      */
+    unsigned long width;        /* a power of two                    */
+    int shift;                  /* bits of a hash not used for a row */
+    unsigned long total;        /* keys added                        */
+} count_min_sketch;
+
+/* Set up an empty sketch with rows of at least 'width' counters. */
+void sketch_init(count_min_sketch *cm, unsigned long width);
+
+void sketch_free(count_min_sketch *cm);
+
+/* Count one more of the key with hash 'hash'; return its new count. */
+unsigned long sketch_add(count_min_sketch *cm, unsigned long hash);
+
+/* The count of the key with hash 'hash'. */
+unsigned long sketch_estimate(count_min_sketch *cm, unsigned long hash);
+
+#endif  /* SKETCH_H */
@@ -0,0 +1,314 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: snapshot.c
+ *
+ *       Implementation of hash table snapshots.
+ *
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "snapshot.h"
+#include "memcheck.h"
+
+/* A pair on its way into the file. */
+
+typedef struct
+{
+    char *key;
+    size_t len;
+    int value;
+    unsigned long hash;
+} pending;
+
+typedef struct
+{
+    pending *p;
+    unsigned long n;
+    unsigned long key_bytes;
+    unsigned long seed;
+} save_arg;
+
+static void count_pair(char *key, int value, unsigned long hash, void *arg);
+static void add_pair(char *key, int value, unsigned long hash, void *arg);
+static int write_snapshot(FILE *fp, save_arg *s, unsigned long nslots);
+
+
+/*** Saving. ***/
+
+static void count_pair(char *key, int value, unsigned long hash, void *arg)
+{
+    save_arg *s;
+    s = (save_arg *) arg;
+    s->n++;
+    s->key_bytes += strlen(key) + 1;
+}
+
+
+/*
+ * The table's own hash isn't kept: the snapshot has a seed of its own,
+ * so this file needn't know which table implementation it is given.
+ */
+static void add_pair(char *key, int value, unsigned long hash, void *arg)
+{
+    save_arg *s;
+    pending *p;
+    s = (save_arg *) arg;
+    p = &s->p[s->n++];
+    p->key = key;
+    p->len = strlen(key);
+    p->value = value;
+    p->hash = hash_n(key, p->len, s->seed);
+}
+
+
+int save_hash_tables(hash_table **tables, int ntables, char *filename)
+{
+    save_arg s;
+    unsigned long nslots;
+    FILE *fp;
+    int i, result;
+
+    s.n = 0;
+    s.key_bytes = 0;
+    for (i = 0; i < ntables; i++)
+    {
+        foreach_entry(tables[i], count_pair, &s);
+    }
+
+    s.p = (pending *) malloc((s.n + 1) * sizeof(pending));
+    if (s.p == NULL)
+    {
+        return -1;
+    }
+    s.n = 0;
+    s.seed = hash_seed();
+    for (i = 0; i < ntables; i++)
+    {
+        foreach_entry(tables[i], add_pair, &s);
+    }
+
+    /* At most one key per slot on average. */
+    nslots = 1;
+    while (nslots < s.n)
+    {
+        nslots *= 2;
+    }
+
+    fp = fopen(filename, "wb");
+    if (fp == NULL)
+    {
+        free(s.p);
+        return -1;
+    }
+
+    result = write_snapshot(fp, &s, nslots);
+
+    if (fclose(fp) != 0)
+    {
+        result = -1;
+    }
+
+    free(s.p);
+    return result;
+}
+
+
+/* Lay the pairs out by slot and write the file. */
+static int write_snapshot(FILE *fp, save_arg *s, unsigned long nslots)
+{
+    snapshot_header header;
+    snapshot_entry *entries;
+    unsigned long *first, *next;
+    unsigned long i, slot, offset;
+    int ok;
+
+    first = (unsigned long *) calloc(nslots + 1, sizeof(unsigned long));
+    next = (unsigned long *) malloc(nslots * sizeof(unsigned long));
+    entries = (snapshot_entry *) malloc((s->n + 1) * sizeof(snapshot_entry));
+    if (first == NULL || next == NULL || entries == NULL)
+    {
+        if (first != NULL) free(first);
+        if (next != NULL) free(next);
+        if (entries != NULL) free(entries);
+        return -1;
+    }
+
+    /* Count the entries of each slot, then place them (a counting sort). */
+    for (i = 0; i < s->n; i++)
+    {
+        first[(s->p[i].hash & (nslots - 1)) + 1]++;
+    }
+    for (i = 0; i < nslots; i++)
+    {
+        first[i + 1] += first[i];
+        next[i] = first[i];
+    }
+
+    offset = 0;
+    for (i = 0; i < s->n; i++)
+    {
+        slot = s->p[i].hash & (nslots - 1);
+        entries[next[slot]].hash = s->p[i].hash;
+        entries[next[slot]].key = offset;
+        entries[next[slot]].len = s->p[i].len;
+        entries[next[slot]].value = s->p[i].value;
+        next[slot]++;
+        offset += s->p[i].len + 1;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.seed = s->seed;
+    header.nslots = nslots;
+    header.nkeys = s->n;
+    header.key_bytes = s->key_bytes;
+
+    ok = fwrite(&header, sizeof(header), 1, fp) == 1
+         && fwrite(first, sizeof(unsigned long), nslots + 1, fp)
+            == nslots + 1
+         && fwrite(entries, sizeof(snapshot_entry), s->n, fp) == s->n;
+
+    /* The keys go out in the order their offsets were handed out. */
+    for (i = 0; ok && i < s->n; i++)
+    {
+        ok = fwrite(s->p[i].key, 1, s->p[i].len + 1, fp)
+             == s->p[i].len + 1;
+    }
+
+    free(first);
+    free(next);
+    free(entries);
+    return ok ? 0 : -1;
+}
+
+
+/*** Loading. ***/
+
+hash_snapshot *load_hash_table(char *filename)
+{
+    hash_snapshot *snap;
+    snapshot_header *h;
+    struct stat st;
+    size_t need;
+    void *map;
+    int fd;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    if (fstat(fd, &st) < 0 || (size_t) st.st_size < sizeof(snapshot_header))
+    {
+        close(fd);
+        return NULL;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return NULL;
+    }
+
+    /* Check the header, and that the file is as long as it says. */
+    h = (snapshot_header *) map;
+    need = 0;
+    if (memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(h->magic)) == 0
+        && h->version == SNAPSHOT_VERSION
+        && h->nslots > 0 && (h->nslots & (h->nslots - 1)) == 0)
+    {
+        need = sizeof(snapshot_header)
+               + (h->nslots + 1) * sizeof(unsigned long)
+               + h->nkeys * sizeof(snapshot_entry)
+               + h->key_bytes;
+    }
+    /*
+     * (The entries themselves aren't checked, which would mean reading
+     * the whole file; a snapshot is trusted once its shape is right.)
+     */
+    if (need == 0 || need != (size_t) st.st_size
+        || ((unsigned long *) (h + 1))[h->nslots] != h->nkeys)
+    {
+        munmap(map, st.st_size);
+        return NULL;
+    }
+
+    snap = (hash_snapshot *) malloc(sizeof(hash_snapshot));
+    if (snap == NULL)
+    {
+        munmap(map, st.st_size);
+        return NULL;
+    }
+
+    snap->map = (char *) map;
+    snap->map_size = st.st_size;
+    snap->header = h;
+    snap->first = (unsigned long *) (snap->map + sizeof(snapshot_header));
+    snap->entries = (snapshot_entry *) (snap->first + h->nslots + 1);
+    snap->keys = (char *) (snap->entries + h->nkeys);
+    return snap;
+}
+
+
+void close_snapshot(hash_snapshot *snap)
+{
+    munmap(snap->map, snap->map_size);
+    free(snap);
+}
+
+
+/*** Lookups. ***/
+
+int snapshot_get_value_n(hash_snapshot *snap, char *key, size_t len)
+{
+    unsigned long h, i, end, slot;
+    snapshot_entry *e;
+
+    h = hash_n(key, len, snap->header->seed);
+    slot = h & (snap->header->nslots - 1);
+    end = snap->first[slot + 1];
+
+    for (i = snap->first[slot]; i < end; i++)
+    {
+        e = &snap->entries[i];
+        if (e->hash == h && e->len == len
+            && memcmp(snap->keys + e->key, key, len) == 0)
+        {
+            return e->value;
+        }
+    }
+
+    return 0;
+}
+
+
+int snapshot_get_value(hash_snapshot *snap, char *key)
+{
+    return snapshot_get_value_n(snap, key, strlen(key));
+}
+
+
+void print_snapshot(hash_snapshot *snap)
+{
+    unsigned long i;
+    snapshot_entry *e;
+
+    for (i = 0; i < snap->header->nkeys; i++)
+    {
+        e = &snap->entries[i];
+        printf("%s %d\n", snap->keys + e->key, e->value);
+    }
+}
@@ -0,0 +1,89 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: snapshot.h
+ *
+ *       Saving a hash table to a binary file, and using the file as a
+ *       read-only table straight from an mmap.
+ *
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stddef.h>
+#include "hash_table.h"
+
+/*
+ * The file format.  Everything is in host byte order and 'unsigned
+ * long' size, so a snapshot is only for the kind of machine that
+ * wrote it.
+ *
+ *   header         snapshot_header
+ *   first          nslots + 1 unsigned longs: the entries of slot i
+ *                  are entries [first[i], first[i + 1])
+ *   entries        nkeys snapshot_entry structs, grouped by slot
+ *   keys           the keys, each followed by a zero byte
+ *
+ * A lookup hashes the key with the stored seed and scans the slot's
+ * entries, which sit next to each other; the key bytes are only read
+ * when the hashes match.
+ */
+
+#define SNAPSHOT_MAGIC   "HTSNAP\r\n"    /* 8 bytes, no zero byte */
+#define SNAPSHOT_VERSION 1
+
+typedef struct
+{
+    char magic[8];
+    unsigned long version;
+    unsigned long seed;
+    unsigned long nslots;       /* a power of two */
+    unsigned long nkeys;
+    unsigned long key_bytes;    /* size of the key blob */
+} snapshot_header;
+
+typedef struct
+{
+    unsigned long hash;
+    unsigned long key;          /* offset of the key in the key blob */
+    unsigned int len;
+    int value;
+} snapshot_entry;
+
+/* A loaded snapshot.  All the pointers point into the mapping. */
+
+typedef struct
+{
+    char *map;
+    size_t map_size;
+    snapshot_header *header;
+    unsigned long *first;
+    snapshot_entry *entries;
+    char *keys;
+} hash_snapshot;
+
+/*
+ * Write the pairs of 'ntables' tables with no keys in common (such as
+ * the ones count_words_parallel makes) to 'filename', as one table.
+ * Returns 0 on success, -1 on error.
+ */
+int save_hash_tables(hash_table **tables, int ntables, char *filename);
+
+/*
+ * Map a snapshot file.  Nothing is read or allocated per entry; the
+ * pages come in as lookups touch them.  Returns NULL if the file
+ * can't be opened or isn't a valid snapshot.
+ */
+hash_snapshot *load_hash_table(char *filename);
+
+void close_snapshot(hash_snapshot *snap);
+
+/* Look up a key, as get_value does.  Returns 0 if it isn't there. */
+int snapshot_get_value(hash_snapshot *snap, char *key);
+int snapshot_get_value_n(hash_snapshot *snap, char *key, size_t len);
+
+/* Print the key/value pairs, as print_hash_table does. */
+void print_snapshot(hash_snapshot *snap);
+
+#endif  /* SNAPSHOT_H */
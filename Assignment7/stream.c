@@ -0,0 +1,159 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: stream.c
+ *
+ *       Implementation of counting a stream.  Only the table's
+ *       functions are used, so this works with either table.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include "stream.h"
+#include "tokenizer.h"
+#include "report.h"
+#include "sketch.h"
+#include "memcheck.h"
+
+static hash_table *trim_table(hash_table *ht, unsigned long keep);
+static hash_table *report(hash_table *ht, long k, unsigned long nwords,
+                          hash_table *last);
+
+
+/*
+ * Make a new table of the 'keep' highest counts of 'ht', and free
+ * 'ht'.
+ */
+static hash_table *trim_table(hash_table *ht, unsigned long keep)
+{
+    hash_table *trimmed;
+    count_entry *counts;
+    size_t i, n;
+
+    counts = extract_counts(&ht, 1, &n);
+    n = top_counts(counts, n, keep);
+
+    trimmed = create_hash_table();
+    for (i = 0; i < n; i++)
+    {
+        *find_or_insert_copy(trimmed, counts[i].key) = counts[i].count;
+    }
+
+    free(counts);
+    free_hash_table(ht);
+    return trimmed;
+}
+
+
+/*
+ * Print the top 'k' words of 'ht' with how much they have gone up
+ * since the report whose counts are in 'last' (NULL for none).
+ * Returns the table of this report's counts, and frees 'last'.
+ */
+static hash_table *report(hash_table *ht, long k, unsigned long nwords,
+                          hash_table *last)
+{
+    hash_table *shown;
+    count_entry *counts;
+    size_t i, n, distinct;
+    int before;
+
+    counts = extract_counts(&ht, 1, &distinct);
+    n = top_counts(counts, distinct, k);
+
+    printf("# %lu words, %lu distinct\n", nwords, (unsigned long) distinct);
+    shown = create_hash_table();
+    for (i = 0; i < n; i++)
+    {
+        before = last == NULL ? 0 : get_value(last, counts[i].key);
+        printf("%s %d %+d\n", counts[i].key, counts[i].count,
+               counts[i].count - before);
+        *find_or_insert_copy(shown, counts[i].key) = counts[i].count;
+    }
+    fflush(stdout);
+
+    free(counts);
+    if (last != NULL)
+    {
+        free_hash_table(last);
+    }
+    return shown;
+}
+
+
+hash_table *count_stream(int fd, stream_options *o)
+{
+    stream_tokenizer t;
+    count_min_sketch cm;
+    hash_table *ht, *last;
+    unsigned long nwords, seed, estimate, keys;
+    char *word;
+    size_t len;
+    int *value;
+
+    ht = create_hash_table();
+    last = NULL;
+    nwords = 0;
+    keys = 0;
+    seed = hash_seed();
+
+    if (o->max_keys > 0)
+    {
+        sketch_init(&cm, o->max_keys * SKETCH_WIDTH_PER_KEY);
+    }
+
+    init_stream_tokenizer(&t, fd);
+
+    while (next_stream_word(&t, &word, &len))
+    {
+        value = find_or_insert_n(ht, word, len);
+
+        if (o->max_keys == 0)
+        {
+            (*value)++;
+        }
+        else
+        {
+            estimate = sketch_add(&cm, hash_n(word, len, seed));
+            if (*value == 0)
+            {
+                /* new to the table, if not to the sketch */
+                *value = estimate > INT_MAX ? INT_MAX : (int) estimate;
+                if (++keys > o->max_keys)
+                {
+                    keys = o->max_keys * TRIM_KEEP_PERCENT / 100;
+                    ht = trim_table(ht, keys);
+                }
+            }
+            else
+            {
+                (*value)++;
+            }
+        }
+
+        nwords++;
+        if (o->every > 0 && nwords % o->every == 0)
+        {
+            last = report(ht, o->top_k, nwords, last);
+        }
+    }
+
+    if (t.error)
+    {
+        fprintf(stderr, "Error reading the input; "
+                        "the counts are of what was read.\n");
+    }
+
+    free_stream_tokenizer(&t);
+    if (o->max_keys > 0)
+    {
+        sketch_free(&cm);
+    }
+    if (last != NULL)
+    {
+        free_hash_table(last);
+    }
+    return ht;
+}
@@ -0,0 +1,58 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: stream.h
+ *
+ *       Counting the words of a stream (standard input, a pipe, a log
+ *       being written) as they arrive, with reports along the way.
+ *
+ */
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include "hash_table.h"
+
+/* Words in a report if no number is given. */
+#define STREAM_TOP_K 10
+
+/*
+ * Counters per key of the table's bound in the count-min sketch, and
+ * how much of the table is kept when it is cut back.
+ */
+#define SKETCH_WIDTH_PER_KEY 8
+#define TRIM_KEEP_PERCENT    50
+
+typedef struct
+{
+    long top_k;                 /* words in each report              */
+    unsigned long every;        /* words between reports, 0 for none */
+    unsigned long max_keys;     /* bound on the table's keys, or 0   */
+} stream_options;
+
+/*
+ * Count the words read from 'fd' until the end of the stream, and
+ * return the table of counts.
+ *
+ * Every 'every' words the 'top_k' most frequent words so far are
+ * printed, with how much each has gone up since the report before,
+ * as
+ *
+ *     # 2000000 words, 51213 distinct
+ *     the 120443 +60112
+ *     ...
+ *
+ * and standard output is flushed, so a reader on the other end of a
+ * pipe sees each report as it is made.
+ *
+ * With a 'max_keys' bound the memory used stays fixed however many
+ * distinct words the stream has.  Every word is also counted in a
+ * count-min sketch, and when the table holds more than 'max_keys'
+ * words it is cut back to the TRIM_KEEP_PERCENT percent with the
+ * highest counts.  A word that comes back after being cut starts
+ * again from its count in the sketch, so the frequent words keep
+ * (nearly) exact counts, and only the long tail is approximate.
+ */
+hash_table *count_stream(int fd, stream_options *o);
+
+#endif  /* STREAM_H */
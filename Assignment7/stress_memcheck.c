@@ -0,0 +1,197 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: stress_memcheck.c
+ *
+ *       Stress test of the memory checker with many threads.
+ *
+ *       The threads allocate blocks and swap them into random slots of
+ *       a shared array, freeing whatever block they take out, so most
+ *       blocks are freed by another thread than the one that allocated
+ *       them.  Each block is filled with a pattern that is checked
+ *       before it is freed.  This is done in 'nrounds' waves of
+ *       threads (so later threads take over the checker's records of
+ *       earlier ones), and every thread leaks exactly one block on
+ *       purpose: the report at the end must list nthreads * nrounds
+ *       leaks and no more.
+ *
+ *       usage: stress_memcheck [-t nthreads] [-r nrounds]
+ *
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "memcheck.h"
+
+#define MAX_THREADS 64
+#define NSLOTS      1024
+#define NALLOCS     200000  /* blocks per thread */
+#define MAX_BLOCK   64
+
+typedef struct
+{
+    unsigned char **slots;
+    unsigned long seed;
+    int errors;
+} worker_arg;
+
+
+void usage(char *progname)
+{
+    fprintf(stderr, "usage: %s [-t nthreads] [-r nrounds]\n", progname);
+}
+
+
+/* A simple generator, so every run does much the same. */
+unsigned long next_random(unsigned long *state)
+{
+    *state = *state * 6364136223846793005UL + 1442695040888963407UL;
+    return *state >> 17;
+}
+
+
+/*
+ * A block's first byte is its size; the rest are that size over and
+ * over.  Returns 1 if 'b' (which may be NULL) is still so.
+ */
+int block_intact(unsigned char *b)
+{
+    int i;
+    if (b == NULL)
+    {
+        return 1;
+    }
+    for (i = 1; i < b[0]; i++)
+    {
+        if (b[i] != b[0])
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+void *worker(void *p)
+{
+    worker_arg *w;
+    unsigned char *b, *leak;
+    unsigned long r;
+    long i;
+    int size;
+
+    w = (worker_arg *) p;
+    for (i = 0; i < NALLOCS; i++)
+    {
+        r = next_random(&w->seed);
+        size = 1 + (int) (r % MAX_BLOCK);
+        b = (unsigned char *) malloc(size);
+        memset(b, size, size);
+
+        b = __atomic_exchange_n(&w->slots[r / MAX_BLOCK % NSLOTS], b,
+                                __ATOMIC_ACQ_REL);
+        if (!block_intact(b))
+        {
+            w->errors++;
+        }
+        if (b != NULL)
+        {
+            free(b);
+        }
+    }
+
+    /* the one leak this thread should be charged with */
+    leak = (unsigned char *) malloc(1);
+    leak[0] = 1;
+    return NULL;
+}
+
+
+int main(int argc, char **argv)
+{
+    unsigned char *slots[NSLOTS];
+    pthread_t tid[MAX_THREADS];
+    worker_arg w[MAX_THREADS];
+    int nthreads, nrounds, argi, round, i, errors;
+
+    nthreads = 4;
+    nrounds = 2;
+
+    for (argi = 1; argi + 1 < argc && argv[argi][0] == '-'; argi += 2)
+    {
+        if (strcmp(argv[argi], "-t") == 0)
+        {
+            nthreads = atoi(argv[argi + 1]);
+        }
+        else if (strcmp(argv[argi], "-r") == 0)
+        {
+            nrounds = atoi(argv[argi + 1]);
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (argi != argc || nthreads < 1 || nthreads > MAX_THREADS
+        || nrounds < 1)
+    {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    memset(slots, 0, sizeof(slots));
+    errors = 0;
+
+    for (round = 0; round < nrounds; round++)
+    {
+        for (i = 0; i < nthreads; i++)
+        {
+            w[i].slots = slots;
+            w[i].seed = (unsigned long) (round * MAX_THREADS + i + 1);
+            w[i].errors = 0;
+            if (pthread_create(&tid[i], NULL, worker, &w[i]) != 0)
+            {
+                fprintf(stderr, "Error: can't create a thread!\n");
+                return 1;
+            }
+        }
+
+        for (i = 0; i < nthreads; i++)
+        {
+            pthread_join(tid[i], NULL);
+            errors += w[i].errors;
+        }
+    }
+
+    /* the blocks left in the slots are freed by this thread */
+    for (i = 0; i < NSLOTS; i++)
+    {
+        if (!block_intact(slots[i]))
+        {
+            errors++;
+        }
+        if (slots[i] != NULL)
+        {
+            free(slots[i]);
+        }
+    }
+
+    if (errors > 0)
+    {
+        printf("Memcheck stress test failed! (%d blocks changed)\n",
+               errors);
+    }
+    else
+    {
+        printf("Memcheck stress test succeeded! (%d threads, %d rounds)\n",
+               nthreads, nrounds);
+    }
+
+    print_memory_leaks();
+    return errors > 0 ? 1 : 0;
+}
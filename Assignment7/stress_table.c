@@ -0,0 +1,313 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: stress_table.c
+ *
+ *       Stress test and benchmark for the concurrent hash table.
+ *
+ *       The words of the input file are split between the writer
+ *       threads, and each counts its share into one shared table
+ *       'nrounds' times over.  Meanwhile a reader thread keeps
+ *       looking words up and checks that no count ever goes down.
+ *       At the end every count is checked against a plain hash_table
+ *       filled by a single thread.
+ *
+ *       usage: stress_table [-t nthreads] [-r nrounds] filename
+ *
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "hash_table.h"
+#include "concurrent_table.h"
+#include "tokenizer.h"
+#include "memcheck.h"
+
+#define MAX_WRITERS 64
+
+typedef struct
+{
+    char *word;
+    size_t len;
+} word_view;
+
+typedef struct
+{
+    concurrent_table *ct;
+    word_view *words;
+    long first, last;   /* this writer's words */
+    int nrounds;
+} writer_arg;
+
+typedef struct
+{
+    concurrent_table *ct;
+    word_view *words;
+    long nwords;
+    volatile int *done;
+    long nlookups;
+    int errors;
+} reader_arg;
+
+typedef struct
+{
+    concurrent_table *ct;
+    int nrounds;
+    int errors;
+} check_arg;
+
+
+void usage(char *progname)
+{
+    fprintf(stderr, "usage: %s [-t nthreads] [-r nrounds] filename\n",
+            progname);
+}
+
+
+void out_of_memory(void)
+{
+    fprintf(stderr, "Error: memory allocation failed! "
+                    "Terminating program.\n");
+    exit(1);
+}
+
+
+double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+void *writer(void *p)
+{
+    writer_arg *w;
+    long i;
+    int r;
+
+    w = (writer_arg *) p;
+    for (r = 0; r < w->nrounds; r++)
+    {
+        for (i = w->first; i < w->last; i++)
+        {
+            concurrent_add_value(w->ct, w->words[i].word, w->words[i].len, 1);
+        }
+    }
+    return NULL;
+}
+
+
+/* Look words up until the writers are done; counts may only grow. */
+void *reader(void *p)
+{
+    reader_arg *r;
+    int *seen;
+    int v;
+    long i;
+
+    r = (reader_arg *) p;
+    seen = (int *) calloc(r->nwords, sizeof(int));
+    if (seen == NULL) out_of_memory();
+
+    r->nlookups = 0;
+    r->errors = 0;
+    i = 0;
+
+    while (!*r->done)
+    {
+        v = concurrent_get_value(r->ct, r->words[i].word, r->words[i].len);
+        if (v < seen[i])
+        {
+            r->errors++;
+        }
+        seen[i] = v;
+        r->nlookups++;
+        i = (i + 7919) % r->nwords;
+    }
+
+    free(seen);
+    return NULL;
+}
+
+
+/* Compare one reference count with the concurrent table. */
+void check_count(char *key, int value, unsigned long hash, void *p)
+{
+    check_arg *c;
+    int v;
+
+    c = (check_arg *) p;
+    v = concurrent_get_value(c->ct, key, strlen(key));
+    if (v != value * c->nrounds)
+    {
+        if (c->errors++ < 10)
+        {
+            fprintf(stderr, "%s: expected %d, got %d\n",
+                    key, value * c->nrounds, v);
+        }
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    input_file input;
+    tokenizer t;
+    word_view *words;
+    long nwords, size, i;
+    int nthreads, nrounds, argi;
+    volatile int done;
+    double start, secs;
+    hash_table *ref;
+    concurrent_table *ct;
+    pthread_t tid[MAX_WRITERS], rtid;
+    writer_arg w[MAX_WRITERS];
+    reader_arg r;
+    check_arg c;
+    char *word;
+    size_t len;
+
+    nthreads = 4;
+    nrounds = 10;
+
+    for (argi = 1; argi + 1 < argc && argv[argi][0] == '-'; argi += 2)
+    {
+        if (strcmp(argv[argi], "-t") == 0)
+        {
+            nthreads = atoi(argv[argi + 1]);
+        }
+        else if (strcmp(argv[argi], "-r") == 0)
+        {
+            nrounds = atoi(argv[argi + 1]);
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (argi != argc - 1 || nthreads < 1 || nthreads > MAX_WRITERS
+        || nrounds < 1)
+    {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    if (open_input_file(argv[argi], &input) < 0)
+    {
+        fprintf(stderr, "Input file \"%s\" does not exist! "
+                        "Terminating program.\n", argv[argi]);
+        return 1;
+    }
+
+    /* Collect the words, and count them once the plain way. */
+    ref = create_hash_table();
+    nwords = 0;
+    size = 1024;
+    words = (word_view *) malloc(size * sizeof(word_view));
+    if (words == NULL) out_of_memory();
+
+    init_tokenizer(&t, input.data, input.size);
+    while (next_word(&t, &word, &len))
+    {
+        if (nwords == size)
+        {
+            word_view *bigger;
+            bigger = (word_view *) malloc(2 * size * sizeof(word_view));
+            if (bigger == NULL) out_of_memory();
+            memcpy(bigger, words, size * sizeof(word_view));
+            free(words);
+            words = bigger;
+            size *= 2;
+        }
+        words[nwords].word = word;
+        words[nwords].len = len;
+        nwords++;
+        increment_value_n(ref, word, len);
+    }
+
+    if (nwords == 0)
+    {
+        fprintf(stderr, "No words in \"%s\".\n", argv[argi]);
+        return 1;
+    }
+
+    /* Count them again, concurrently. */
+    ct = create_concurrent_table();
+    done = 0;
+    r.ct = ct;
+    r.words = words;
+    r.nwords = nwords;
+    r.done = &done;
+
+    if (pthread_create(&rtid, NULL, reader, &r) != 0)
+    {
+        fprintf(stderr, "Error: can't create a thread!\n");
+        return 1;
+    }
+
+    start = now();
+
+    for (i = 0; i < nthreads; i++)
+    {
+        w[i].ct = ct;
+        w[i].words = words;
+        w[i].first = nwords * i / nthreads;
+        w[i].last = nwords * (i + 1) / nthreads;
+        w[i].nrounds = nrounds;
+        if (pthread_create(&tid[i], NULL, writer, &w[i]) != 0)
+        {
+            fprintf(stderr, "Error: can't create a thread!\n");
+            return 1;
+        }
+    }
+
+    for (i = 0; i < nthreads; i++)
+    {
+        pthread_join(tid[i], NULL);
+    }
+
+    secs = now() - start;
+    done = 1;
+    pthread_join(rtid, NULL);
+
+    /* Check the counts. */
+    c.ct = ct;
+    c.nrounds = nrounds;
+    c.errors = 0;
+    foreach_entry(ref, check_count, &c);
+
+    if (concurrent_count(ct) != ref->count)
+    {
+        fprintf(stderr, "expected %lu keys, got %lu\n",
+                ref->count, concurrent_count(ct));
+        c.errors++;
+    }
+
+    printf("%d writers: %.0f updates/s, %ld lookups by the reader\n",
+           nthreads, nwords * (double) nrounds / secs, r.nlookups);
+
+    if (c.errors > 0 || r.errors > 0)
+    {
+        printf("Stress test failed! (%d wrong counts, "
+               "%d counts went down)\n", c.errors, r.errors);
+    }
+    else
+    {
+        printf("Stress test succeeded!\n");
+    }
+
+    free_concurrent_table(ct);
+    free_hash_table(ref);
+    free(words);
+    close_input_file(&input);
+    print_memory_leaks();
+
+    return (c.errors > 0 || r.errors > 0) ? 1 : 0;
+}
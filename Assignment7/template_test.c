@@ -0,0 +1,218 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: template_test.c
+ *
+ *       Test of the tables generated from hash_template.h, with keys
+ *       and values of other types than hash_table's:
+ *
+ *         id_table       unsigned long -> unsigned long
+ *         wc_table       string -> unsigned long
+ *         stats_table    string -> struct word_stats
+ *
+ *       The words of the input file are counted into the string
+ *       tables and checked against a plain hash_table; the integer
+ *       table is filled with scattered ids and checked against the
+ *       values they were given.
+ *
+ *       usage: template_test filename
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "hash_table.h"
+#include "hash_template.h"
+#include "tokenizer.h"
+#include "memcheck.h"
+
+#define NIDS     1000000
+#define ID_STEP  2654435761UL   /* spreads the ids over the whole range */
+
+typedef struct
+{
+    unsigned long count;
+    unsigned long first;        /* position of the first occurrence */
+    unsigned long last;         /* position of the last one         */
+} word_stats;
+
+HASH_TABLE_TYPES(id_table, id_entry, unsigned long, unsigned long);
+HASH_TABLE_TYPES(wc_table, wc_entry, char *, unsigned long);
+HASH_TABLE_TYPES(stats_table, stats_entry, char *, word_stats);
+
+HASH_TABLE_FUNCTIONS(id, id_table, id_entry, unsigned long,
+                     ULONG_HASH, ULONG_EQUAL, ULONG_STORE)
+HASH_TABLE_FUNCTIONS(wc, wc_table, wc_entry, str_view,
+                     STR_HASH, STR_EQUAL, STR_STORE)
+HASH_TABLE_FUNCTIONS(stats, stats_table, stats_entry, str_view,
+                     STR_HASH, STR_EQUAL, STR_STORE)
+
+typedef struct
+{
+    wc_table *counts;
+    stats_table *stats;
+    int errors;
+} check_arg;
+
+
+/* Compare one reference count with the generated tables. */
+void check_word(char *key, int value, unsigned long hash, void *p)
+{
+    check_arg *c;
+    wc_entry *ce;
+    stats_entry *se;
+    str_view k;
+
+    c = (check_arg *) p;
+    k.s = key;
+    k.len = strlen(key);
+    ce = wc_find(c->counts, k);
+    se = stats_find(c->stats, k);
+
+    if (ce == NULL || ce->value != (unsigned long) value
+        || se == NULL || se->value.count != (unsigned long) value
+        || se->value.first > se->value.last)
+    {
+        if (c->errors++ < 10)
+        {
+            fprintf(stderr, "%s: expected %d\n", key, value);
+        }
+    }
+}
+
+
+/* Fill the integer table, then look every id up, and some missing ones. */
+int test_ids(void)
+{
+    id_table ids;
+    id_entry *e;
+    unsigned long i;
+    int errors;
+
+    errors = 0;
+    id_init(&ids, hash_seed());
+
+    for (i = 0; i < NIDS; i++)
+    {
+        id_find_or_insert(&ids, i * ID_STEP)->value = i;
+    }
+
+    for (i = 0; i < NIDS; i++)
+    {
+        e = id_find(&ids, i * ID_STEP);
+        if (e == NULL || e->value != i)
+        {
+            errors++;
+        }
+        if (id_find(&ids, i * ID_STEP + 1) != NULL)
+        {
+            errors++;
+        }
+    }
+
+    if (ids.count != NIDS)
+    {
+        errors++;
+    }
+
+    id_destroy(&ids);
+    return errors;
+}
+
+
+int main(int argc, char **argv)
+{
+    input_file input;
+    tokenizer t;
+    hash_table *ref;
+    wc_table counts;
+    stats_table stats;
+    stats_entry *se;
+    wc_entry *ce;
+    check_arg c;
+    str_view k;
+    unsigned long pos;
+    char *word;
+    size_t len;
+    int errors;
+
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s filename\n", argv[0]);
+        exit(1);
+    }
+
+    if (open_input_file(argv[1], &input) < 0)
+    {
+        fprintf(stderr, "Input file \"%s\" does not exist! "
+                        "Terminating program.\n", argv[1]);
+        return 1;
+    }
+
+    ref = create_hash_table();
+    wc_init(&counts, hash_seed());
+    stats_init(&stats, hash_seed());
+
+    pos = 0;
+    init_tokenizer(&t, input.data, input.size);
+
+    while (next_word(&t, &word, &len))
+    {
+        k.s = word;
+        k.len = len;
+        increment_value_n(ref, word, len);
+        wc_find_or_insert(&counts, k)->value++;
+
+        se = stats_find_or_insert(&stats, k);
+        if (se->value.count++ == 0)
+        {
+            se->value.first = pos;
+        }
+        se->value.last = pos;
+        pos++;
+    }
+
+    c.counts = &counts;
+    c.stats = &stats;
+    c.errors = 0;
+    foreach_entry(ref, check_word, &c);
+    errors = c.errors;
+
+    if (counts.count != stats.count)
+    {
+        errors++;
+    }
+
+    /* The counts are unsigned long, so they can go past INT_MAX. */
+    if (ULONG_MAX > 0xffffffffUL && counts.count > 0)
+    {
+        pos = 0;
+        ce = wc_next(&counts, &pos);
+        ce->value += (unsigned long) INT_MAX + 1;
+        if (ce->value <= (unsigned long) INT_MAX)
+        {
+            errors++;
+        }
+    }
+
+    errors += test_ids();
+
+    if (errors > 0)
+    {
+        printf("Template test failed! (%d errors)\n", errors);
+    }
+    else
+    {
+        printf("Template test succeeded!\n");
+    }
+
+    wc_destroy(&counts);
+    stats_destroy(&stats);
+    free_hash_table(ref);
+    close_input_file(&input);
+    print_memory_leaks();
+
+    return errors > 0 ? 1 : 0;
+}
@@ -0,0 +1,331 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: tokenizer.c
+ *
+ *       Implementation of the zero-copy tokenizer.  Where SSE2 is
+ *       available (all x86-64 machines) the scans for the start and
+ *       end of a word test 16 bytes at a time; elsewhere, or when
+ *       built with -DNO_SIMD, they go byte by byte.
+ *
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "tokenizer.h"
+#include "memcheck.h"
+
+#if defined(__SSE2__) && !defined(NO_SIMD)
+#define USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#define READ_CHUNK (1 << 20)    /* Bytes per read() when not mapping. */
+
+static int read_all(int fd, input_file *in);
+static void refill(stream_tokenizer *t, char *keep);
+static char *skip_space(char *p, char *end);
+static char *skip_word(char *p, char *end);
+
+
+/*** Input files. ***/
+
+int open_input_file(char *filename, input_file *in)
+{
+    int fd;
+    struct stat st;
+    void *p;
+
+    fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    in->data = NULL;
+    in->size = 0;
+    in->mapped = 0;
+
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+    {
+        /* An empty file can't be mapped, and needn't be. */
+        if (st.st_size == 0)
+        {
+            close(fd);
+            return 0;
+        }
+
+        p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED)
+        {
+            in->data = (char *) p;
+            in->size = st.st_size;
+            in->mapped = 1;
+            close(fd);
+            return 0;
+        }
+    }
+
+    /* Not a regular file, or mmap refused: read it instead. */
+    if (read_all(fd, in) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    close(fd);
+    return 0;
+}
+
+
+/* Read all of 'fd' into a buffer that grows as needed. */
+static int read_all(int fd, input_file *in)
+{
+    size_t cap;
+    ssize_t n;
+    char *buf;
+
+    cap = 0;
+
+    while (1)
+    {
+        if (in->size + READ_CHUNK > cap)
+        {
+            cap = 2 * cap + READ_CHUNK;
+            buf = (char *) malloc(cap);
+            if (buf == NULL)
+            {
+                return -1;
+            }
+            if (in->data != NULL)
+            {
+                memcpy(buf, in->data, in->size);
+                free(in->data);
+            }
+            in->data = buf;
+        }
+
+        n = read(fd, in->data + in->size, cap - in->size);
+        if (n <= 0)
+        {
+            return n < 0 ? -1 : 0;
+        }
+
+        in->size += n;
+    }
+}
+
+
+void close_input_file(input_file *in)
+{
+    if (in->mapped)
+    {
+        munmap(in->data, in->size);
+    }
+    else if (in->data != NULL)
+    {
+        free(in->data);
+    }
+
+    in->data = NULL;
+    in->size = 0;
+}
+
+
+/*** Scanning. ***/
+
+#ifdef USE_SSE2
+
+/* Bit i of the result is set if p[i] is whitespace. */
+static unsigned int space_mask(char *p)
+{
+    __m128i c, space, ctrl;
+    c = _mm_loadu_si128((__m128i *) p);
+    space = _mm_cmpeq_epi8(c, _mm_set1_epi8(' '));
+    ctrl = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('\t' - 1)),
+                         _mm_cmplt_epi8(c, _mm_set1_epi8('\r' + 1)));
+    return _mm_movemask_epi8(_mm_or_si128(space, ctrl));
+}
+
+#endif  /* USE_SSE2 */
+
+
+/* Return the first non-whitespace byte at or after 'p', or 'end'. */
+static char *skip_space(char *p, char *end)
+{
+#ifdef USE_SSE2
+    unsigned int m;
+    while (end - p >= 16)
+    {
+        m = ~space_mask(p) & 0xffff;
+        if (m != 0)
+        {
+            return p + __builtin_ctz(m);
+        }
+        p += 16;
+    }
+#endif
+    while (p < end && IS_SPACE(*p))
+    {
+        p++;
+    }
+    return p;
+}
+
+
+/* Return the first whitespace byte at or after 'p', or 'end'. */
+static char *skip_word(char *p, char *end)
+{
+#ifdef USE_SSE2
+    unsigned int m;
+    while (end - p >= 16)
+    {
+        m = space_mask(p);
+        if (m != 0)
+        {
+            return p + __builtin_ctz(m);
+        }
+        p += 16;
+    }
+#endif
+    while (p < end && !IS_SPACE(*p))
+    {
+        p++;
+    }
+    return p;
+}
+
+
+void init_tokenizer(tokenizer *t, char *data, size_t size)
+{
+    t->pos = data;
+    t->end = data + size;
+}
+
+
+int next_word(tokenizer *t, char **word, size_t *len)
+{
+    char *p, *q;
+    p = skip_space(t->pos, t->end);
+    if (p == t->end)
+    {
+        t->pos = p;
+        return 0;
+    }
+    q = skip_word(p, t->end);
+    *word = p;
+    *len = q - p;
+    t->pos = q;
+    return 1;
+}
+
+
+/*** Streams. ***/
+
+void init_stream_tokenizer(stream_tokenizer *t, int fd)
+{
+    t->fd = fd;
+    t->cap = READ_CHUNK;
+    t->buf = (char *) malloc(t->cap);
+    if (t->buf == NULL)
+    {
+        fprintf(stderr, "Error: memory allocation failed! "
+                        "Terminating program.\n");
+        exit(1);
+    }
+    t->pos = t->buf;
+    t->end = t->buf;
+    t->eof = 0;
+    t->error = 0;
+}
+
+
+void free_stream_tokenizer(stream_tokenizer *t)
+{
+    free(t->buf);
+    t->buf = NULL;
+}
+
+
+/*
+ * Move the bytes from 'keep' on (the start of a word, or 'end') to the
+ * front of the buffer and read more after them.  The buffer doubles
+ * if they fill it.
+ */
+static void refill(stream_tokenizer *t, char *keep)
+{
+    size_t used;
+    ssize_t n;
+    char *buf;
+
+    used = t->end - keep;
+    if (used == t->cap)
+    {
+        buf = (char *) malloc(2 * t->cap);
+        if (buf == NULL)
+        {
+            fprintf(stderr, "Error: memory allocation failed! "
+                            "Terminating program.\n");
+            exit(1);
+        }
+        memcpy(buf, keep, used);
+        free(t->buf);
+        t->buf = buf;
+        t->cap *= 2;
+    }
+    else
+    {
+        memmove(t->buf, keep, used);
+    }
+
+    t->pos = t->buf;
+    t->end = t->buf + used;
+
+    n = read(t->fd, t->end, t->cap - used);
+    if (n > 0)
+    {
+        t->end += n;
+    }
+    else
+    {
+        t->eof = 1;
+        t->error = n < 0;
+    }
+}
+
+
+int next_stream_word(stream_tokenizer *t, char **word, size_t *len)
+{
+    char *p, *q;
+
+    for ( ; ; )
+    {
+        p = skip_space(t->pos, t->end);
+        q = skip_word(p, t->end);
+
+        /* a word is whole if there is whitespace after it */
+        if (q < t->end || (t->eof && p < q))
+        {
+            *word = p;
+            *len = q - p;
+            t->pos = q;
+            return 1;
+        }
+
+        if (t->eof)
+        {
+            t->pos = t->end;
+            return 0;
+        }
+
+        refill(t, p);
+    }
+}
@@ -0,0 +1,87 @@
+/*
+ * CS 11, C Track, lab 7
+ *
+ * FILE: tokenizer.h
+ *
+ *       Splitting a whole input file into whitespace-separated words
+ *       without copying them, or a stream (a pipe, say) as it is read.
+ *
+ */
+
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+
+#include <stddef.h>
+
+/*
+ * The contents of an input file: mmapped if possible, otherwise (a
+ * pipe, say) read into a buffer.
+ */
+
+typedef struct
+{
+    char *data;
+    size_t size;
+    int mapped;         /* nonzero if 'data' is an mmapped region */
+} input_file;
+
+/*
+ * Words are views into the input: 'len' bytes at 'word', not zero
+ * terminated.  Whitespace is the same set isspace() has in the C
+ * locale: space, \t, \n, \v, \f and \r.
+ */
+
+#define IS_SPACE(c) ((c) == ' ' || ((c) >= '\t' && (c) <= '\r'))
+
+typedef struct
+{
+    char *pos;          /* where to look for the next word */
+    char *end;
+} tokenizer;
+
+/*
+ * A stream is read READ_CHUNK bytes at a time into a buffer, and split
+ * into words from there.  A word cut off by the end of the buffer is
+ * moved to its front before the next read; the buffer grows if a word
+ * is longer than it.
+ */
+
+typedef struct
+{
+    int fd;
+    char *buf;
+    size_t cap;         /* size of 'buf'                       */
+    char *pos;          /* where to look for the next word     */
+    char *end;          /* end of the data read so far         */
+    int eof;            /* nonzero once a read has returned 0  */
+    int error;          /* nonzero if a read failed            */
+} stream_tokenizer;
+
+/* Open and map a file.  Returns 0 on success, -1 if it can't be read. */
+int open_input_file(char *filename, input_file *in);
+
+void close_input_file(input_file *in);
+
+void init_tokenizer(tokenizer *t, char *data, size_t size);
+
+/*
+ * Find the next word.  Returns 1 and sets '*word' and '*len', or
+ * returns 0 at the end of the input.
+ */
+int next_word(tokenizer *t, char **word, size_t *len);
+
+/* Start reading words from the file descriptor 'fd'. */
+void init_stream_tokenizer(stream_tokenizer *t, int fd);
+
+/* Free the buffer.  The file descriptor is left open. */
+void free_stream_tokenizer(stream_tokenizer *t);
+
+/*
+ * Find the next word of the stream, reading more of it as needed.
+ * Returns 1 and sets '*word' and '*len', or returns 0 at the end of
+ * the stream (or if it can't be read; 't->error' says which).  The
+ * word is only good until the next call.
+ */
+int next_stream_word(stream_tokenizer *t, char **word, size_t *len);
+
+#endif  /* TOKENIZER_H */
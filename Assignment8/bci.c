@@ -6,15 +6,28 @@
  *
  */
 
+#define _POSIX_C_SOURCE 200112L  /* for vsnprintf, clock_gettime */
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
 #include <assert.h>
+#include <time.h>
 #include "bci.h"
+#include "trace.h"
 
 
 /* Define the virtual machine. */
 vm_type vm;
 
+/* Execution limits; these outlive 'init_vm'.  0 means no limit. */
+static long max_insts = 0;
+static long timeout_ms = 0;
+
+static double now(void);
+static int loop_cost(int from, int to);
+
 
 /* Initialize the virtual machine. */
 void init_vm(void)
@@ -49,9 +62,165 @@ void init_vm(void)
     for (i = 0; i < MAX_INSTS; i++)
     {
         vm.inst[i] = 0;
+        vm.loop_cost[i] = 0;
+    }
+
+    vm.ip = 0;
+    vm.ninsts = 0;
+    vm.out = stdout;
+    vm.in = NULL;
+    vm.trap = NULL;
+    vm.errmsg[0] = '\0';
+
+    trace_reset();
+}
+
+
+/*
+ * Reset the stack and registers but leave the instruction buffer
+ * alone, so a program that is already loaded can be run again.
+ */
+void reset_vm(void)
+{
+    int i;
+
+    vm.sp = 0;
+
+    for (i = 0; i < NREGS; i++)
+    {
+        vm.reg[i] = 0;
     }
 
     vm.ip = 0;
+    vm.errmsg[0] = '\0';
+}
+
+
+/*
+ * Report an error in the running program.  The message is kept in
+ * 'vm.errmsg'; if a trap is set we unwind to it, otherwise we print
+ * the message and exit like the rest of the interpreter does.
+ */
+void vm_error(char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    vsnprintf(vm.errmsg, ERRMSG_SIZE, fmt, ap);
+    va_end(ap);
+
+    if (vm.trap != NULL)
+    {
+        longjmp(*vm.trap, 1);
+    }
+
+    fprintf(stderr, "%s, exiting\n", vm.errmsg);
+    exit(EXIT_FAILURE);
+}
+
+
+/*
+ * Execution limits.
+ */
+
+void set_vm_limits(long insts, long ms)
+{
+    max_insts = insts;
+    timeout_ms = ms;
+}
+
+
+/* Monotonic time in seconds. */
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/* Start the limit counters for a new run of the program. */
+static void start_limits(void)
+{
+    vm.insts_run = 0;
+    vm.nbackjumps = 0;
+    vm.deadline = (timeout_ms > 0) ? now() + timeout_ms / 1000.0 : 0;
+}
+
+
+int instruction_size(unsigned char op)
+{
+    switch (op)
+    {
+    case PUSH:
+        return 5;
+
+    case LOAD:
+    case STORE:
+        return 2;
+
+    case JMP:
+    case JZ:
+    case JNZ:
+        return 3;
+
+    default:
+        return 1;
+    }
+}
+
+
+/*
+ * Number of instructions from 'to' up to and including the jump at
+ * 'from'.  This is worked out the first time the jump is taken and
+ * cached in 'vm.loop_cost'.  If 'to' turns out not to be on an
+ * instruction boundary we fall back to counting bytes.
+ */
+static int loop_cost(int from, int to)
+{
+    int ip, n;
+
+    if (vm.loop_cost[from] == 0)
+    {
+        n = 0;
+
+        for (ip = to; ip < from; ip += instruction_size(vm.inst[ip]))
+        {
+            n++;
+        }
+
+        vm.loop_cost[from] = (ip == from) ? n + 1 : from - to + 1;
+    }
+
+    return vm.loop_cost[from];
+}
+
+
+void backward_jump(int from, int to)
+{
+    if ((max_insts == 0) && (timeout_ms == 0))
+    {
+        return;
+    }
+
+    vm.insts_run += loop_cost(from, to);
+    vm.nbackjumps++;
+
+    if ((max_insts > 0) && (vm.insts_run > max_insts))
+    {
+        vm_error("instruction budget of %ld exhausted "
+                 "at ip %d jumping back to %d",
+                 max_insts, from, to);
+    }
+
+    if (((vm.nbackjumps & (TIME_CHECK_INTERVAL - 1)) == 0)
+        && (timeout_ms > 0) && (now() > vm.deadline))
+    {
+        vm_error("time limit of %ld ms exceeded after %ld instructions "
+                 "at ip %d jumping back to %d",
+                 timeout_ms, vm.insts_run, from, to);
+    }
 }
 
 
@@ -102,8 +271,7 @@ void do_push(int n)
     /* if there is no room left on the stack */
     if (vm.sp >= STACK_SIZE - 1)
     {
-        fprintf(stderr, "stack overflow on PUSH %d, exiting\n", n);
-        exit(EXIT_FAILURE);
+        vm_error("stack overflow on PUSH %d", n);
     }
     /* otherwise */
     /* add the value at the TOS (index of stack pointer) */
@@ -117,8 +285,7 @@ void do_pop(void)
     /* if there is nothing on the stack */
     if (vm.sp <= 0)
     {
-        fprintf(stderr, "failed to pop from an empty stack, exiting\n");
-        exit(EXIT_FAILURE);
+        vm_error("failed to pop from an empty stack");
     }
     /* otherwise */
     /* decrement the stack pointer,
@@ -152,6 +319,11 @@ void do_jmp(int n)
     /* if the instruction index is invalid, exit */
     check_instruction_index(n);
     /* otherwise */
+    /* jumping back to loop again is where the limits are checked */
+    if (n <= vm.ip - instruction_size(JMP))
+    {
+        backward_jump(vm.ip - instruction_size(JMP), n);
+    }
     /* set the instruction pointer to the new position */
     vm.ip = n;
 }
@@ -166,9 +338,14 @@ void do_jz(int n)
     /* if the TOS is zero, set the instruction pointer to the new position */
     if (vm.stack[vm.sp - 1] == 0)
     {
+        if (n <= vm.ip - instruction_size(JZ))
+        {
+            backward_jump(vm.ip - instruction_size(JZ), n);
+        }
         vm.ip = n;
     }
-    /* otherwise do nothing */
+    /* either way, pop the TOS */
+    do_pop();
 }
 
 void do_jnz(int n)
@@ -182,9 +359,14 @@ void do_jnz(int n)
      * set the instruction pointer to the new position */
     if (vm.stack[vm.sp - 1] != 0)
     {
+        if (n <= vm.ip - instruction_size(JNZ))
+        {
+            backward_jump(vm.ip - instruction_size(JNZ), n);
+        }
         vm.ip = n;
     }
-    /* otherwise do nothing */
+    /* either way, pop the TOS */
+    do_pop();
 }
 
 void do_add(void)
@@ -225,8 +407,18 @@ void do_div(void)
     /* if the stack does not have two values in it, exit */
     check_stack_size(2);
     /* otherwise */
+    /* dividing by zero would crash the interpreter itself */
+    if (vm.stack[vm.sp - 1] == 0)
+    {
+        vm_error("division by zero");
+    }
+    /* and so would the one quotient that doesn't fit in an int */
+    if (vm.stack[vm.sp - 2] == INT_MIN && vm.stack[vm.sp - 1] == -1)
+    {
+        vm_error("integer overflow dividing %d by -1", INT_MIN);
+    }
     /* divide S2 (TOS - 1) by S1 (TOS) */
-    vm.stack[vm.sp - 2] = vm.stack[vm.sp - 2] / vm.stack[vm.sp - 2];
+    vm.stack[vm.sp - 2] = vm.stack[vm.sp - 2] / vm.stack[vm.sp - 1];
     /* pop the last (non-overwritten) value (TOS) */
     do_pop();
 }
@@ -236,18 +428,41 @@ void do_print(void)
     /* check that the stack has a value as TOS */
     check_stack_size(1);
     /* print out the TOS followed by a newline */
-    fprintf(stdout, "%d\n", vm.stack[vm.sp - 1]);
+    fprintf(vm.out, "%d\n", vm.stack[vm.sp - 1]);
     do_pop();
 }
 
+int next_input(void)
+{
+    int val;
+    int status = 0;
+
+    /* with no input stream attached, READ just sees the end of input */
+    if (vm.in != NULL)
+    {
+        status = read_int(vm.in, &val);
+    }
+
+    if (status < 0)
+    {
+        vm_error("READ: invalid integer in input");
+    }
+
+    return (status > 0) ? val : READ_EOF;
+}
+
+void do_read(void)
+{
+    do_push(next_input());
+}
+
 /* check to see that the registry index is valid */
 void check_registry_index(unsigned char n)
 {
     /* if the registry index is invalid */
     if (n >= NREGS || n < 0)
     {
-        fprintf(stderr, "invalid registry index %d, exiting\n", n);
-        exit(EXIT_FAILURE);
+        vm_error("invalid registry index %d", n);
     }
 }
 
@@ -257,8 +472,7 @@ void check_instruction_index(unsigned short n)
     /* if the registry index is invalid */
     if (n >= MAX_INSTS || n < 0)
     {
-        fprintf(stderr, "invalid instruction index %d, exiting\n", n);
-        exit(EXIT_FAILURE);
+        vm_error("invalid instruction index %d", n);
     }
 }
 
@@ -268,10 +482,8 @@ void check_stack_size(unsigned char min_length)
     /* if the stack is not big enough */
     if (vm.sp < min_length)
     {
-        fprintf(stderr,
-        "operation needs %d operands on the stack, not enough found, exiting\n",
-        min_length);
-        exit(EXIT_FAILURE);
+        vm_error("operation needs %d operands on the stack, "
+                 "not enough found", min_length);
     }
 }
 
@@ -285,21 +497,39 @@ void check_stack_size(unsigned char min_length)
 /* Load the stored program into the VM. */
 void load_program(FILE *fp)
 {
-    int nread;
-    unsigned char *inst = vm.inst;
+    /*
+     * Read the whole file into the 'vm.inst' array in one go.
+     * 'fread' returns the number of bytes read, which can be less
+     * than MAX_INSTS if EOF is hit first.
+     */
 
-    do
-    {
-        /*
-         * Read a single byte at a time and load it into the
-         * 'vm.insts' array.  'fread' returns the number of bytes read,
-         * or 0 if EOF is hit.
-         */
+    vm.ninsts = fread(vm.inst, 1, MAX_INSTS, fp);
+}
+
+
+/*
+ * Load a program that is already in memory.  Whatever is left of a
+ * previously loaded, longer program is cleared so that running off
+ * the end of the new one still hits zeroes (NOPs) as it would after
+ * 'init_vm'.
+ */
+void load_program_bytes(unsigned char *code, int n)
+{
+    assert((n >= 0) && (n <= MAX_INSTS));
+
+    memcpy(vm.inst, code, n);
 
-        nread = fread(inst, 1, 1, fp);
-        inst++;
+    if (vm.ninsts > n)
+    {
+        memset(vm.inst + n, 0, vm.ninsts - n);
     }
-    while (nread > 0);
+
+    /* Loop costs and traces of the old program mean nothing now. */
+    memset(vm.loop_cost, 0,
+           (vm.ninsts > n ? vm.ninsts : n) * sizeof(vm.loop_cost[0]));
+    trace_reset();
+
+    vm.ninsts = n;
 }
 
 
@@ -307,10 +537,14 @@ void load_program(FILE *fp)
 /* Execute the stored program in the VM. */
 void execute_program(void)
 {
-    int val;
+    int val, site;
 
     vm.ip = 0;
     vm.sp = 0;
+    start_limits();
+
+    /* In case an earlier run was stopped by an error inside a trace. */
+    trace_running = 0;
 
     while (1)
     {
@@ -321,6 +555,9 @@ void execute_program(void)
          * instruction.
          */
 
+        /* 'vm.ip' moves while the arguments are read; this doesn't. */
+        vm.op_ip = vm.ip;
+
         switch (vm.inst[vm.ip])
         {
         case NOP:
@@ -359,29 +596,46 @@ void execute_program(void)
             break;
 
         case JMP:
+            site = vm.ip;
             vm.ip++;
 
             /* Read in the next two bytes. */
             val = read_n_byte_integer(2);
             do_jmp(val);
+
+            /* A backward jump closes a loop, which may be hot. */
+            if (vm.ip <= site)
+            {
+                trace_loop();
+            }
             break;
 
         case JZ:
+            site = vm.ip;
             vm.ip++;
             /* perform the conditional jump */
             /* use a two byte integer assuming a maximum instruction index of
              * 65535 (16 bits/2 bytes) */
             val = read_n_byte_integer(2);
             do_jz(val);
+            if (vm.ip <= site)
+            {
+                trace_loop();
+            }
             break;
 
         case JNZ:
+            site = vm.ip;
             vm.ip++;
             /* perform the conditional jump */
             /* use a two byte integer assuming a maximum instruction index of
              * 65535 (16 bits/2 bytes) */
-            val = read_n_byte_integer(1);
+            val = read_n_byte_integer(2);
             do_jnz(val);
+            if (vm.ip <= site)
+            {
+                trace_loop();
+            }
             break;
 
         case ADD:
@@ -414,21 +668,29 @@ void execute_program(void)
             do_print();
             break;
 
+        case READ:
+            vm.ip++;
+            /* push the next integer from the input stream */
+            do_read();
+            break;
+
         case STOP:
             return;
 
         default:
-            fprintf(stderr, "execute_program: invalid instruction: %x\n",
-                    vm.inst[vm.ip]);
-            fprintf(stderr, "\taborting program!\n");
+            vm_error("execute_program: invalid instruction: %x",
+                     vm.inst[vm.ip]);
             return;
         }
     }
 }
 
 
-/* Run the program given the file name in which it's stored. */
-void run_program(char *filename)
+/*
+ * Run the program given the file name in which it's stored.  READ
+ * instructions take their input from 'in', which may be NULL.
+ */
+void run_program(char *filename, input_stream *in)
 {
     FILE *fp;
 
@@ -444,6 +706,7 @@ void run_program(char *filename)
 
     /* Initialize the virtual machine. */
     init_vm();
+    vm.in = in;
 
     /* Read the bytecode into the instruction buffer. */
     load_program(fp);
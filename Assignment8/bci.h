@@ -10,6 +10,9 @@
 #define BCI_H
 
 #include <stdio.h>
+#include <limits.h>
+#include <setjmp.h>
+#include "reader.h"
 
 /*
  * The instruction set.  Each instruction fits into a single byte.
@@ -63,6 +66,15 @@
 #define DIV     0x0b  /* DIV: S2 / S1 -> TOS                        */
 #define PRINT   0x0c  /* PRINT: print TOS to stdout and pop TOS.    */
 #define STOP    0x0d  /* STOP: halt the program.                    */
+#define READ    0x0e  /* READ: push the next integer from the
+                         input stream to TOS, or READ_EOF if the
+                         input is exhausted.                        */
+
+/*
+ * Value pushed by READ at the end of the input.  An input value that
+ * happens to equal READ_EOF can't be told apart from the real end.
+ */
+#define READ_EOF INT_MIN
 
 
 /*
@@ -77,6 +89,15 @@
 #define NREGS      16       /* Number of registers. */
 #define MAX_INSTS  65536    /* Maximum number of instructions. */
 #define STACK_SIZE 256      /* Size of the stack. */
+#define ERRMSG_SIZE 256     /* Size of the error message buffer. */
+
+/*
+ * Errors in the bytecode (stack overflow, bad register, ...) are
+ * reported through 'vm_error'.  If 'trap' is NULL the message is
+ * printed and the process exits; otherwise the message is left in
+ * 'errmsg' and control unwinds to 'trap' with longjmp, so that a
+ * long-lived host (see server.c) can survive a bad program.
+ */
 
 typedef struct
 {
@@ -85,6 +106,20 @@ typedef struct
     int reg[NREGS];                  /* Registers.           */
     unsigned char inst[MAX_INSTS];   /* Instructions.        */
     unsigned short ip;               /* Instruction pointer. */
+    unsigned short op_ip;            /* Start of the instruction
+                                        being executed, for the
+                                        profiler's signal handler. */
+    int ninsts;                      /* Bytes of loaded code.  */
+    FILE *out;                       /* Where PRINT writes to. */
+    input_stream *in;                /* Where READ reads from,
+                                        or NULL for no input.   */
+    jmp_buf *trap;                   /* Error unwind target.   */
+    char errmsg[ERRMSG_SIZE];        /* Last error message.    */
+    long insts_run;                  /* Instructions charged.  */
+    long nbackjumps;                 /* Backward jumps taken.  */
+    double deadline;                 /* Time limit, or 0.      */
+    unsigned int loop_cost[MAX_INSTS];    /* Per backward jump,
+                                             0 if not known yet. */
 } vm_type;
 
 /* Declare the VM 'extern' so all files can access the same VM. */
@@ -93,6 +128,39 @@ extern vm_type vm;
 /* Function to initialize the VM. */
 void init_vm(void);
 
+/*
+ * Reset the stack and registers, keeping the loaded program.  This is
+ * much cheaper than 'init_vm' and is all a warm VM needs between runs.
+ */
+void reset_vm(void);
+
+/* Report a bytecode error (printf-style) and stop the program. */
+void vm_error(char *fmt, ...);
+
+/*
+ * Execution limits.
+ *
+ * Limits are only checked when a jump goes backwards, since a program
+ * can only run for long by looping.  Each backward jump is charged the
+ * number of instructions between its target and the jump itself (the
+ * static length of the loop), so the instruction count is an upper
+ * bound on what the loops really executed.  The clock is read only
+ * every TIME_CHECK_INTERVAL backward jumps.
+ *
+ * A program that exceeds a limit is stopped with 'vm_error', naming
+ * the jump it was taking.  A limit of 0 means no limit.
+ */
+
+#define TIME_CHECK_INTERVAL 64     /* Must be a power of two. */
+
+void set_vm_limits(long max_insts, long timeout_ms);
+
+/* Called by every dispatch loop when a jump from 'from' to 'to' is taken. */
+void backward_jump(int from, int to);
+
+/* The size in bytes of an instruction (opcode plus arguments). */
+int instruction_size(unsigned char op);
+
 /*
  * Utility function to convert byte streams of varying widths
  * to integers.
@@ -115,6 +183,10 @@ void do_sub(void);
 void do_mul(void);
 void do_div(void);
 void do_print(void);
+void do_read(void);
+
+/* The value READ pushes: the next input integer, or READ_EOF. */
+int next_input(void);
 
 
 /*
@@ -122,8 +194,9 @@ void do_print(void);
  */
 
 void load_program(FILE *fp);
+void load_program_bytes(unsigned char *code, int n);
 void execute_program(void);
-void run_program(char *filename);
+void run_program(char *filename, input_stream *in);
 
 /*
  * helper functions
@@ -0,0 +1,207 @@
+/*
+ * CS 11, C track, lab 8
+ *
+ * FILE: bci_client.c
+ *       Command-line client for the bytecode server ("bci --serve").
+ *
+ *       The program id sent to the server is a hash of the bytecode,
+ *       so the first request only names the program; the code itself
+ *       is sent only if the server answers that it hasn't seen it.
+ *
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "bci.h"
+#include "server.h"
+
+#define REPLY_OK    0
+#define REPLY_MISS  1
+#define REPLY_ERROR 2
+
+#define MAX_LINE    256
+
+
+void usage(char *progname)
+{
+    fprintf(stderr, "usage: %s socket filename [reg0 [reg1 ...]]\n",
+            progname);
+}
+
+
+/* FNV-1a hash of the bytecode, used as its program id. */
+unsigned int program_id(unsigned char *code, int n)
+{
+    int i;
+    unsigned int h = 2166136261u;
+
+    for (i = 0; i < n; i++)
+    {
+        h ^= code[i];
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
+
+/* Write all of 'buf' to 'fd'.  Returns 0 on success. */
+int write_all(int fd, void *buf, int n)
+{
+    char *p = (char *) buf;
+    ssize_t nw;
+
+    while (n > 0)
+    {
+        nw = write(fd, p, n);
+
+        if (nw <= 0)
+        {
+            return -1;
+        }
+
+        p += nw;
+        n -= nw;
+    }
+
+    return 0;
+}
+
+
+/*
+ * Send one request and copy the program output to stdout.  If
+ * 'send_code' is zero only the program id is sent.  Returns one of
+ * the REPLY_* codes.
+ */
+int send_request(char *sockpath, unsigned int id, int *regs, int nregs,
+                 unsigned char *code, int ncode, int send_code)
+{
+    int fd;
+    unsigned int hdr[4];
+    struct sockaddr_un addr;
+    char line[MAX_LINE];
+    FILE *in;
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd < 0)
+    {
+        perror("bci_client: socket");
+        return REPLY_ERROR;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, sockpath, sizeof(addr.sun_path) - 1);
+
+    if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+    {
+        perror("bci_client: connect");
+        close(fd);
+        return REPLY_ERROR;
+    }
+
+    hdr[0] = REQUEST_MAGIC;
+    hdr[1] = id;
+    hdr[2] = nregs;
+    hdr[3] = send_code ? ncode : 0;
+
+    if ((write_all(fd, hdr, sizeof(hdr)) < 0)
+        || (write_all(fd, regs, nregs * sizeof(int)) < 0)
+        || (send_code && (write_all(fd, code, ncode) < 0)))
+    {
+        perror("bci_client: write");
+        close(fd);
+        return REPLY_ERROR;
+    }
+
+    in = fdopen(fd, "r");
+
+    if (in == NULL)
+    {
+        close(fd);
+        return REPLY_ERROR;
+    }
+
+    /* Output lines are passed through until the status line arrives. */
+    while (fgets(line, MAX_LINE, in) != NULL)
+    {
+        if (line[0] != '!')
+        {
+            fputs(line, stdout);
+        }
+        else if (strcmp(line, "!ok\n") == 0)
+        {
+            fclose(in);
+            return REPLY_OK;
+        }
+        else if (strcmp(line, "!miss\n") == 0)
+        {
+            fclose(in);
+            return REPLY_MISS;
+        }
+        else
+        {
+            fprintf(stderr, "bci_client: %s", line + 1);
+            fclose(in);
+            return REPLY_ERROR;
+        }
+    }
+
+    fprintf(stderr, "bci_client: connection closed without a status\n");
+    fclose(in);
+    return REPLY_ERROR;
+}
+
+
+int main(int argc, char **argv)
+{
+    static unsigned char code[MAX_INSTS];
+    int regs[NREGS];
+    int i, nregs, ncode, reply;
+    unsigned int id;
+    FILE *fp;
+
+    if ((argc < 3) || (argc - 3 > NREGS))
+    {
+        usage(argv[0]);
+        exit(1);
+    }
+
+    fp = fopen(argv[2], "r");
+
+    if (fp == NULL)
+    {
+        fprintf(stderr, "bci_client: error opening file %s\n", argv[2]);
+        exit(1);
+    }
+
+    ncode = fread(code, 1, MAX_INSTS, fp);
+    fclose(fp);
+
+    nregs = argc - 3;
+
+    for (i = 0; i < nregs; i++)
+    {
+        regs[i] = atoi(argv[i + 3]);
+    }
+
+    id = program_id(code, ncode);
+
+    /* Try the cached copy first; fall back to sending the code. */
+    reply = send_request(argv[1], id, regs, nregs, code, ncode, 0);
+
+    if (reply == REPLY_MISS)
+    {
+        reply = send_request(argv[1], id, regs, nregs, code, ncode, 1);
+    }
+
+    return (reply == REPLY_OK) ? 0 : 1;
+}
@@ -8,24 +8,146 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "bci.h"
+#include "server.h"
+#include "trace.h"
+#include "profile.h"
+
+
+/*
+ * The profile being taken, if any.  It is written out by an exit
+ * handler, so that a run stopped by an error or a limit (which exits
+ * from vm_error) still leaves its profile.
+ */
+static FILE *profile = NULL;
+static char *profiled_program = NULL;
+
+static void finish_profile(void);
 
 
 void usage(char *progname)
 {
-    fprintf(stderr, "usage: %s filename\n", progname);
+    fprintf(stderr, "usage: %s [limits] [--input file] [--binary] "
+            "[--profile out] filename\n", progname);
+    fprintf(stderr, "       %s [limits] --serve socket [--workers n]\n",
+            progname);
+    fprintf(stderr, "limits: [--max-insts n] [--timeout ms] [--no-trace]\n");
+}
+
+
+static void finish_profile(void)
+{
+    stop_profile();
+    write_profile(profile, profiled_program);
+    fclose(profile);
+    profile = NULL;
 }
 
 
 int main(int argc, char **argv)
 {
-    if (argc != 2)
+    int i;
+    int nworkers = DEFAULT_WORKERS;
+    int format = INPUT_TEXT;
+    long max_insts = 0;
+    long timeout_ms = 0;
+    char *filename = NULL;
+    char *sockpath = NULL;
+    char *inputname = NULL;
+    char *profilename = NULL;
+    input_stream *in;
+
+    for (i = 1; i < argc; i++)
+    {
+        if ((strcmp(argv[i], "--serve") == 0) && (i + 1 < argc))
+        {
+            sockpath = argv[++i];
+        }
+        else if ((strcmp(argv[i], "--workers") == 0) && (i + 1 < argc))
+        {
+            nworkers = atoi(argv[++i]);
+        }
+        else if ((strcmp(argv[i], "--input") == 0) && (i + 1 < argc))
+        {
+            inputname = argv[++i];
+        }
+        else if (strcmp(argv[i], "--binary") == 0)
+        {
+            format = INPUT_BINARY;
+        }
+        else if ((strcmp(argv[i], "--profile") == 0) && (i + 1 < argc))
+        {
+            profilename = argv[++i];
+        }
+        else if (strcmp(argv[i], "--no-trace") == 0)
+        {
+            set_tracing(0);
+        }
+        else if ((strcmp(argv[i], "--max-insts") == 0) && (i + 1 < argc))
+        {
+            max_insts = atol(argv[++i]);
+        }
+        else if ((strcmp(argv[i], "--timeout") == 0) && (i + 1 < argc))
+        {
+            timeout_ms = atol(argv[++i]);
+        }
+        else if ((filename == NULL) && (argv[i][0] != '-'))
+        {
+            filename = argv[i];
+        }
+        else
+        {
+            usage(argv[0]);
+            exit(1);
+        }
+    }
+
+    /* Exactly one of a program to run or a socket to serve on. */
+    if (((filename == NULL) == (sockpath == NULL)) || (nworkers < 1)
+        || (max_insts < 0) || (timeout_ms < 0))
     {
         usage(argv[0]);
         exit(1);
     }
 
-    run_program(argv[1]);
+    /* In server mode the limits apply to every request. */
+    set_vm_limits(max_insts, timeout_ms);
+
+    if (sockpath != NULL)
+    {
+        return serve(sockpath, nworkers);
+    }
+
+    /* READ takes its input from stdin unless a file is given. */
+    in = open_input(inputname, format);
+
+    if (in == NULL)
+    {
+        fprintf(stderr, "%s: error opening input file %s\n",
+                argv[0], inputname);
+        exit(1);
+    }
+
+    if (profilename != NULL)
+    {
+        profile = fopen(profilename, "w");
+
+        if (profile == NULL)
+        {
+            fprintf(stderr, "%s: error opening profile file %s\n",
+                    argv[0], profilename);
+            exit(1);
+        }
+
+        profiled_program = filename;
+        atexit(finish_profile);
+        start_profile();
+    }
+
+    run_program(filename, in);
+
+    close_input(in);
 
     return 0;
 }
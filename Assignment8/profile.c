@@ -0,0 +1,172 @@
+/*
+ * CS 11, C track, lab 8
+ *
+ * FILE: profile.c
+ *       Bytecode-level sampling profiler.  See profile.h.
+ *
+ */
+
+#define _XOPEN_SOURCE 600  /* for SA_RESTART */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/time.h>
+#include "bci.h"
+#include "trace.h"
+#include "profile.h"
+
+#define MAX_LOOPS 1024
+
+
+static unsigned long samples[MAX_INSTS];        /* Per instruction.  */
+static unsigned long trace_samples[MAX_INSTS];  /* Per trace header. */
+
+static char *op_names[] =
+{
+    "NOP", "PUSH", "POP", "LOAD", "STORE", "JMP", "JZ", "JNZ",
+    "ADD", "SUB", "MUL", "DIV", "PRINT", "STOP", "READ"
+};
+
+/* Backward jumps in the program: loop 'i' spans to[i] .. from[i]. */
+static int nloops;
+static int loop_to[MAX_LOOPS];
+static int loop_from[MAX_LOOPS];
+
+
+static void take_sample(int sig);
+static void find_loops(void);
+static int enclosing_loop(int ip);
+
+
+static void take_sample(int sig)
+{
+    (void) sig;
+
+    if (trace_running)
+    {
+        trace_samples[vm.op_ip]++;
+    }
+    else
+    {
+        samples[vm.op_ip]++;
+    }
+}
+
+
+void start_profile(void)
+{
+    struct sigaction sa;
+    struct itimerval timer;
+
+    memset(samples, 0, sizeof(samples));
+    memset(trace_samples, 0, sizeof(trace_samples));
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = take_sample;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGPROF, &sa, NULL);
+
+    timer.it_interval.tv_sec = 0;
+    timer.it_interval.tv_usec = PROFILE_INTERVAL_US;
+    timer.it_value = timer.it_interval;
+    setitimer(ITIMER_PROF, &timer, NULL);
+}
+
+
+void stop_profile(void)
+{
+    struct itimerval timer;
+
+    memset(&timer, 0, sizeof(timer));
+    setitimer(ITIMER_PROF, &timer, NULL);
+    signal(SIGPROF, SIG_IGN);
+}
+
+
+/* Collect the backward jumps, decoding the program from the start. */
+static void find_loops(void)
+{
+    int ip, target;
+    unsigned char op;
+
+    nloops = 0;
+
+    for (ip = 0; ip < vm.ninsts; ip += instruction_size(op))
+    {
+        op = vm.inst[ip];
+
+        if (((op == JMP) || (op == JZ) || (op == JNZ))
+            && (ip + 2 < MAX_INSTS) && (nloops < MAX_LOOPS))
+        {
+            target = vm.inst[ip + 1] | (vm.inst[ip + 2] << 8);
+
+            if (target <= ip)
+            {
+                loop_to[nloops] = target;
+                loop_from[nloops] = ip;
+                nloops++;
+            }
+        }
+    }
+}
+
+
+/* The innermost loop containing 'ip', or -1. */
+static int enclosing_loop(int ip)
+{
+    int i, best = -1;
+
+    for (i = 0; i < nloops; i++)
+    {
+        if ((loop_to[i] <= ip) && (ip <= loop_from[i])
+            && ((best < 0) || (loop_from[i] - loop_to[i]
+                               < loop_from[best] - loop_to[best])))
+        {
+            best = i;
+        }
+    }
+
+    return best;
+}
+
+
+void write_profile(FILE *fp, char *progname)
+{
+    int ip, loop;
+    unsigned char op;
+    char *base;
+
+    /* Frame names can't contain ';', so use just the file name. */
+    base = strrchr(progname, '/');
+    base = (base != NULL) ? base + 1 : progname;
+
+    find_loops();
+
+    for (ip = 0; ip < MAX_INSTS; ip++)
+    {
+        if (samples[ip] > 0)
+        {
+            loop = enclosing_loop(ip);
+            op = vm.inst[ip];
+            fprintf(fp, "%s;", base);
+
+            if (loop >= 0)
+            {
+                fprintf(fp, "loop@%d;", loop_to[loop]);
+            }
+
+            fprintf(fp, "%s@%d %lu\n",
+                    (op <= READ) ? op_names[op] : "INVALID", ip,
+                    samples[ip]);
+        }
+
+        if (trace_samples[ip] > 0)
+        {
+            fprintf(fp, "%s;loop@%d;trace %lu\n", base, ip,
+                    trace_samples[ip]);
+        }
+    }
+}
@@ -0,0 +1,37 @@
+/*
+ * CS 11, C track, lab 8
+ *
+ * FILE: profile.h
+ *       Header file for the bytecode-level sampling profiler.
+ *
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdio.h>
+
+/*
+ * While profiling, a SIGPROF timer fires every PROFILE_INTERVAL_US
+ * microseconds of CPU time and the handler counts the instruction the
+ * VM is executing ('vm.op_ip'), or the loop whose trace is running.
+ * The counts are written out as folded stacks, one line per
+ * instruction:
+ *
+ *   program;loop@<header>;<OPCODE>@<ip> <samples>
+ *   program;loop@<header>;trace <samples>
+ *
+ * which flamegraph.pl and similar tools take as input.  The loop frame
+ * is the innermost backward jump range around the instruction, and is
+ * left out for instructions that aren't in a loop.
+ */
+
+#define PROFILE_INTERVAL_US 1000
+
+void start_profile(void);
+void stop_profile(void);
+
+/* Write the samples for the loaded program, named 'progname'. */
+void write_profile(FILE *fp, char *progname);
+
+#endif  /* PROFILE_H */
@@ -0,0 +1,216 @@
+/*
+ * CS 11, C track, lab 8
+ *
+ * FILE: reader.c
+ *       Buffered integer input stream for the READ instruction.
+ *
+ *       Input is pulled from the file descriptor in large blocks with
+ *       read(2) and integers are decoded straight out of the buffer,
+ *       so there is no per-integer system call or stdio locking.
+ *
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "reader.h"
+
+
+static int fill(input_stream *in);
+static int is_space(unsigned char c);
+
+
+input_stream *open_input(char *filename, int format)
+{
+    input_stream *in;
+    int fd;
+
+    if (filename == NULL)
+    {
+        fd = 0;
+    }
+    else
+    {
+        fd = open(filename, O_RDONLY);
+
+        if (fd < 0)
+        {
+            return NULL;
+        }
+    }
+
+    in = (input_stream *) malloc(sizeof(input_stream));
+
+    if (in != NULL)
+    {
+        in->buf = (unsigned char *) malloc(INPUT_BUF_SIZE);
+    }
+
+    if ((in == NULL) || (in->buf == NULL))
+    {
+        fprintf(stderr, "reader.c: open_input: out of memory\n");
+        exit(1);
+    }
+
+    in->fd = fd;
+    in->format = format;
+    in->eof = 0;
+    in->pos = in->buf;
+    in->end = in->buf;
+
+    return in;
+}
+
+
+void close_input(input_stream *in)
+{
+    if (in->fd != 0)
+    {
+        close(in->fd);
+    }
+
+    free(in->buf);
+    free(in);
+}
+
+
+/*
+ * Move the unread bytes to the front of the buffer and do one read
+ * to top it up.  Returns the number of bytes now available.
+ */
+static int fill(input_stream *in)
+{
+    size_t left = in->end - in->pos;
+    ssize_t n;
+
+    memmove(in->buf, in->pos, left);
+    in->pos = in->buf;
+    in->end = in->buf + left;
+
+    while (!in->eof)
+    {
+        n = read(in->fd, in->end, INPUT_BUF_SIZE - left);
+
+        if (n > 0)
+        {
+            in->end += n;
+            break;
+        }
+        else if ((n == 0) || (errno != EINTR))
+        {
+            in->eof = 1;
+        }
+    }
+
+    return in->end - in->pos;
+}
+
+
+static int is_space(unsigned char c)
+{
+    return (c == ' ') || (c == '\n') || (c == '\t') || (c == '\r')
+           || (c == '\f') || (c == '\v');
+}
+
+
+int read_int(input_stream *in, int *val)
+{
+    unsigned char *p, *end;
+    unsigned int v, limit, digit;
+    int neg, ndigits;
+
+    if (in->format == INPUT_BINARY)
+    {
+        while (in->end - in->pos < 4)
+        {
+            /* a few bytes left over are a cut-off integer, not EOF */
+            if (in->eof)
+            {
+                return (in->end == in->pos) ? 0 : -1;
+            }
+
+            fill(in);
+        }
+
+        memcpy(val, in->pos, 4);
+        in->pos += 4;
+        return 1;
+    }
+
+    /* Skip leading whitespace, refilling as often as it takes. */
+    while (1)
+    {
+        while ((in->pos < in->end) && is_space(*in->pos))
+        {
+            in->pos++;
+        }
+
+        if (in->pos < in->end)
+        {
+            break;
+        }
+
+        if (fill(in) == 0)
+        {
+            return 0;
+        }
+    }
+
+    neg = 0;
+
+    if ((*in->pos == '-') || (*in->pos == '+'))
+    {
+        neg = (*in->pos == '-');
+        in->pos++;
+    }
+
+    /*
+     * Accumulate digits.  The inner loop runs over the buffer with no
+     * checks but the range one; we only come back around if the
+     * number straddles the end of the buffer.  A negative number may
+     * go one past INT_MAX, so that INT_MIN can be read.
+     */
+    limit = (unsigned int) INT_MAX + (neg ? 1u : 0u);
+    v = 0;
+    ndigits = 0;
+
+    while (1)
+    {
+        p = in->pos;
+        end = in->end;
+
+        while ((p < end) && ((digit = (unsigned int) (*p - '0')) < 10))
+        {
+            if (v > (limit - digit) / 10)
+            {
+                in->pos = p;
+                return -1;
+            }
+            v = v * 10 + digit;
+            p++;
+        }
+
+        ndigits += p - in->pos;
+        in->pos = p;
+
+        if ((p < end) || (fill(in) == 0))
+        {
+            break;
+        }
+    }
+
+    /* The number has to end at whitespace or at the end of the input. */
+    if ((ndigits == 0) || ((in->pos < in->end) && !is_space(*in->pos)))
+    {
+        return -1;
+    }
+
+    *val = (int) (neg ? 0u - v : v);
+    return 1;
+}
@@ -0,0 +1,51 @@
+/*
+ * CS 11, C track, lab 8
+ *
+ * FILE: reader.h
+ *       Buffered integer input stream for the READ instruction.
+ *
+ */
+
+#ifndef READER_H
+#define READER_H
+
+#define INPUT_BUF_SIZE (1 << 20)    /* Bytes read from the fd at once. */
+
+/*
+ * Input formats:
+ *
+ *   INPUT_TEXT:   decimal integers separated by whitespace.
+ *   INPUT_BINARY: packed 4-byte integers in host byte order;
+ *                 a trailing partial integer is ignored.
+ */
+
+#define INPUT_TEXT   0
+#define INPUT_BINARY 1
+
+typedef struct
+{
+    int fd;                 /* Where the data comes from.           */
+    int format;             /* INPUT_TEXT or INPUT_BINARY.          */
+    int eof;                /* Nonzero once 'fd' has hit EOF.       */
+    unsigned char *buf;     /* INPUT_BUF_SIZE bytes.                */
+    unsigned char *pos;     /* Next unread byte in 'buf'.           */
+    unsigned char *end;     /* One past the last valid byte.        */
+} input_stream;
+
+/*
+ * Open an input stream on 'filename', or on stdin if 'filename' is
+ * NULL.  Returns NULL if the file can't be opened.
+ */
+input_stream *open_input(char *filename, int format);
+
+void close_input(input_stream *in);
+
+/*
+ * Read the next integer into '*val'.  Returns 1 on success, 0 at the
+ * end of the input and -1 if the input isn't a valid integer: text
+ * that is not a number or is out of the range of an int, or binary
+ * input that ends part way through one.
+ */
+int read_int(input_stream *in, int *val);
+
+#endif  /* READER_H */
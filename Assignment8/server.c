@@ -0,0 +1,576 @@
+/*
+ * CS 11, C track, lab 8
+ *
+ * FILE: server.c
+ *       Long-lived bytecode server.
+ *
+ *       The parent process binds a Unix domain socket and forks a pool
+ *       of worker processes.  Each worker owns one warm VM (the global
+ *       'vm' of that process) and a small cache of programs, and
+ *       handles its connections with epoll.  A worker only copies a
+ *       program into its VM when it differs from the one already
+ *       loaded, so repeated runs of the same program cost no more than
+ *       resetting the stack and registers.
+ *
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/epoll.h>
+#include "bci.h"
+#include "server.h"
+
+#define MAX_EVENTS   64     /* epoll events handled per wakeup. */
+#define MAX_REQUEST  (REQUEST_HDR_SIZE + NREGS * 4 + MAX_INSTS)
+
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE 0    /* Older kernels: accept the thundering herd. */
+#endif
+
+
+/*
+ * A client connection and the part of its request read so far.
+ */
+
+typedef struct
+{
+    int fd;
+    int nread;                          /* Bytes received so far.     */
+    int size;                           /* Full request size, or 0 if
+                                           the header isn't in yet.   */
+    unsigned char buf[MAX_REQUEST];     /* The request.               */
+} connection;
+
+
+/*
+ * A program held in a worker's cache.
+ */
+
+typedef struct
+{
+    int used;
+    unsigned int id;
+    int ninsts;
+    unsigned char *code;
+} cached_program;
+
+
+static cached_program cache[PROGRAM_CACHE_SIZE];
+static int cache_next = 0;              /* Next slot to evict.          */
+static cached_program *loaded = NULL;   /* Program currently in the VM. */
+
+static volatile sig_atomic_t stopping = 0;
+
+
+/*
+ * Helper functions.
+ */
+
+static unsigned int get_u32(unsigned char *p);
+static void set_blocking(int fd, int blocking);
+static void send_status(int fd, char *status);
+static cached_program *find_program(unsigned int id);
+static cached_program *cache_program(unsigned int id,
+                                     unsigned char *code, int n);
+static int read_request(connection *c);
+static void run_request(connection *c);
+static void accept_connections(int epfd, int listen_fd);
+static void run_worker(int listen_fd);
+static pid_t spawn_worker(int listen_fd);
+static void handle_stop(int sig);
+
+
+/* Read a 4-byte host-order integer from the request buffer. */
+static unsigned int get_u32(unsigned char *p)
+{
+    unsigned int val;
+
+    memcpy(&val, p, 4);
+    return val;
+}
+
+
+static void set_blocking(int fd, int blocking)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+
+    if (blocking)
+    {
+        flags &= ~O_NONBLOCK;
+    }
+    else
+    {
+        flags |= O_NONBLOCK;
+    }
+
+    fcntl(fd, F_SETFL, flags);
+}
+
+
+/* Send a status line on a connection whose request couldn't be run. */
+static void send_status(int fd, char *status)
+{
+    ssize_t n;
+
+    n = write(fd, status, strlen(status));
+    (void) n;   /* Nothing to be done if the client has gone away. */
+}
+
+
+/*
+ * Program cache.
+ */
+
+static cached_program *find_program(unsigned int id)
+{
+    int i;
+
+    for (i = 0; i < PROGRAM_CACHE_SIZE; i++)
+    {
+        if (cache[i].used && cache[i].id == id)
+        {
+            return &cache[i];
+        }
+    }
+
+    return NULL;
+}
+
+
+/*
+ * Store a copy of 'code' under 'id', replacing any program with the
+ * same id, or else evicting slots round-robin.
+ */
+static cached_program *cache_program(unsigned int id,
+                                     unsigned char *code, int n)
+{
+    cached_program *p;
+
+    p = find_program(id);
+
+    if (p == NULL)
+    {
+        p = &cache[cache_next];
+        cache_next = (cache_next + 1) % PROGRAM_CACHE_SIZE;
+    }
+
+    /* The VM no longer holds what this slot describes. */
+    if (p == loaded)
+    {
+        loaded = NULL;
+    }
+
+    free(p->code);
+    p->code = (unsigned char *) malloc(n > 0 ? n : 1);
+
+    if (p->code == NULL)
+    {
+        fprintf(stderr, "bci server: out of memory, exiting\n");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(p->code, code, n);
+    p->used = 1;
+    p->id = id;
+    p->ninsts = n;
+    return p;
+}
+
+
+/*
+ * Read as much of a request as is available without blocking.
+ * Returns 1 once the whole request is in, 0 if more is needed and
+ * -1 if the connection should be dropped.
+ */
+static int read_request(connection *c)
+{
+    ssize_t n;
+    int want;
+    unsigned int nregs, ncode;
+
+    while (1)
+    {
+        /* Once the header is in we know how much else to expect. */
+        if ((c->size == 0) && (c->nread >= REQUEST_HDR_SIZE))
+        {
+            nregs = get_u32(c->buf + 8);
+            ncode = get_u32(c->buf + 12);
+
+            if ((get_u32(c->buf) != REQUEST_MAGIC) || (nregs > NREGS)
+                || (ncode > MAX_INSTS))
+            {
+                send_status(c->fd, "!error bad request header\n");
+                return -1;
+            }
+
+            c->size = REQUEST_HDR_SIZE + 4 * nregs + ncode;
+        }
+
+        if ((c->size > 0) && (c->nread == c->size))
+        {
+            return 1;
+        }
+
+        want = (c->size > 0 ? c->size : REQUEST_HDR_SIZE) - c->nread;
+        n = read(c->fd, c->buf + c->nread, want);
+
+        if (n > 0)
+        {
+            c->nread += n;
+        }
+        else if (n == 0)
+        {
+            return -1;   /* Client hung up mid-request. */
+        }
+        else if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+        {
+            return 0;
+        }
+        else if (errno != EINTR)
+        {
+            return -1;
+        }
+    }
+}
+
+
+/*
+ * Run a complete request on this worker's VM, streaming the PRINT
+ * output and the final status line back to the client.  The
+ * connection is closed when this returns.
+ */
+static void run_request(connection *c)
+{
+    unsigned int id, nregs, ncode, i;
+    unsigned char *code;
+    cached_program *p;
+    jmp_buf trap;
+    FILE *out;
+
+    id    = get_u32(c->buf + 4);
+    nregs = get_u32(c->buf + 8);
+    ncode = get_u32(c->buf + 12);
+    code  = c->buf + REQUEST_HDR_SIZE + 4 * nregs;
+
+    /* The reply is written with stdio, which wants a blocking socket. */
+    set_blocking(c->fd, 1);
+    out = fdopen(c->fd, "w");
+
+    if (out == NULL)
+    {
+        close(c->fd);
+        return;
+    }
+
+    if (ncode > 0)
+    {
+        p = cache_program(id, code, ncode);
+    }
+    else
+    {
+        p = find_program(id);
+    }
+
+    if (p == NULL)
+    {
+        fputs("!miss\n", out);
+        fclose(out);
+        return;
+    }
+
+    /* Only touch the instruction buffer if the VM isn't already warm. */
+    if (p != loaded)
+    {
+        load_program_bytes(p->code, p->ninsts);
+        loaded = p;
+    }
+
+    reset_vm();
+
+    for (i = 0; i < nregs; i++)
+    {
+        vm.reg[i] = (int) get_u32(c->buf + REQUEST_HDR_SIZE + 4 * i);
+    }
+
+    vm.out = out;
+    vm.trap = &trap;
+
+    if (setjmp(trap) == 0)
+    {
+        execute_program();
+        fputs("!ok\n", out);
+    }
+    else
+    {
+        fprintf(out, "!error %s\n", vm.errmsg);
+    }
+
+    vm.trap = NULL;
+    vm.out = stdout;
+    fclose(out);
+}
+
+
+/* Accept every pending connection and start watching it. */
+static void accept_connections(int epfd, int listen_fd)
+{
+    int fd;
+    connection *c;
+    struct epoll_event ev;
+
+    while (1)
+    {
+        fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+        if (fd < 0)
+        {
+            /* EAGAIN: another worker got there first, or we're done. */
+            return;
+        }
+
+        c = (connection *) malloc(sizeof(connection));
+
+        if (c == NULL)
+        {
+            send_status(fd, "!error server out of memory\n");
+            close(fd);
+            continue;
+        }
+
+        c->fd = fd;
+        c->nread = 0;
+        c->size = 0;
+
+        ev.events = EPOLLIN;
+        ev.data.ptr = c;
+
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+        {
+            close(fd);
+            free(c);
+        }
+    }
+}
+
+
+/* The body of a worker process.  Never returns. */
+static void run_worker(int listen_fd)
+{
+    int epfd, n, i, status;
+    connection *c;
+    struct epoll_event ev, events[MAX_EVENTS];
+
+    /* Warm up: this is the only full 'init_vm' the worker ever does. */
+    init_vm();
+
+    epfd = epoll_create1(EPOLL_CLOEXEC);
+
+    if (epfd < 0)
+    {
+        perror("bci server: epoll_create1");
+        exit(EXIT_FAILURE);
+    }
+
+    /* A NULL pointer marks the listening socket. */
+    ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+    ev.data.ptr = NULL;
+
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, listen_fd, &ev) < 0)
+    {
+        perror("bci server: epoll_ctl");
+        exit(EXIT_FAILURE);
+    }
+
+    while (1)
+    {
+        n = epoll_wait(epfd, events, MAX_EVENTS, -1);
+
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            perror("bci server: epoll_wait");
+            exit(EXIT_FAILURE);
+        }
+
+        for (i = 0; i < n; i++)
+        {
+            c = (connection *) events[i].data.ptr;
+
+            if (c == NULL)
+            {
+                accept_connections(epfd, listen_fd);
+                continue;
+            }
+
+            status = read_request(c);
+
+            if (status == 0)
+            {
+                continue;   /* Wait for the rest of the request. */
+            }
+
+            epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, NULL);
+
+            if (status > 0)
+            {
+                run_request(c);     /* Closes the connection. */
+            }
+            else
+            {
+                close(c->fd);
+            }
+
+            free(c);
+        }
+    }
+}
+
+
+static pid_t spawn_worker(int listen_fd)
+{
+    pid_t pid;
+
+    pid = fork();
+
+    if (pid == 0)
+    {
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        run_worker(listen_fd);
+    }
+    else if (pid < 0)
+    {
+        perror("bci server: fork");
+    }
+
+    return pid;
+}
+
+
+static void handle_stop(int sig)
+{
+    (void) sig;
+    stopping = 1;
+}
+
+
+int serve(char *sockpath, int nworkers)
+{
+    int listen_fd, i;
+    pid_t pid, *workers;
+    struct sockaddr_un addr;
+    struct sigaction sa;
+
+    if (strlen(sockpath) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "bci server: socket path too long: %s\n", sockpath);
+        return 1;
+    }
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    if (listen_fd < 0)
+    {
+        perror("bci server: socket");
+        return 1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, sockpath);
+    unlink(sockpath);
+
+    if ((bind(listen_fd, (struct sockaddr *) &addr, sizeof(addr)) < 0)
+        || (listen(listen_fd, SOMAXCONN) < 0))
+    {
+        perror("bci server: bind");
+        close(listen_fd);
+        return 1;
+    }
+
+    /* Workers share the socket and must never block in accept. */
+    set_blocking(listen_fd, 0);
+
+    /* A client that hangs up early shouldn't kill its worker. */
+    signal(SIGPIPE, SIG_IGN);
+
+    workers = (pid_t *) malloc(nworkers * sizeof(pid_t));
+
+    if (workers == NULL)
+    {
+        fprintf(stderr, "bci server: out of memory\n");
+        close(listen_fd);
+        return 1;
+    }
+
+    for (i = 0; i < nworkers; i++)
+    {
+        workers[i] = spawn_worker(listen_fd);
+    }
+
+    /* No SA_RESTART, so 'wait' below returns when we're told to stop. */
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_stop;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    /* Replace any worker that dies until we're asked to shut down. */
+    while (!stopping)
+    {
+        pid = wait(NULL);
+
+        if (pid < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+
+            break;
+        }
+
+        for (i = 0; i < nworkers; i++)
+        {
+            if ((workers[i] == pid) && !stopping)
+            {
+                fprintf(stderr, "bci server: worker %d died, restarting\n",
+                        (int) pid);
+                workers[i] = spawn_worker(listen_fd);
+            }
+        }
+    }
+
+    for (i = 0; i < nworkers; i++)
+    {
+        if (workers[i] > 0)
+        {
+            kill(workers[i], SIGTERM);
+        }
+    }
+
+    while (wait(NULL) > 0)
+    {
+        /* Reap the workers. */
+    }
+
+    free(workers);
+    close(listen_fd);
+    unlink(sockpath);
+    return 0;
+}
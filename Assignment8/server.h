@@ -0,0 +1,50 @@
+/*
+ * CS 11, C track, lab 8
+ *
+ * FILE: server.h
+ *       Header file for the bytecode server ("bci --serve").
+ *
+ */
+
+#ifndef SERVER_H
+#define SERVER_H
+
+/*
+ * Wire protocol.
+ *
+ * A request is a fixed-size header followed by the initial register
+ * values and the bytecode.  All integers are 4 bytes in host byte
+ * order (the server only listens on a Unix domain socket):
+ *
+ *   magic     REQUEST_MAGIC
+ *   id        program id chosen by the client
+ *   nregs     number of initial register values that follow (<= NREGS)
+ *   ncode     number of bytecode bytes that follow (<= MAX_INSTS),
+ *             or 0 to run the program already cached under 'id'
+ *   regs      'nregs' integers, loaded into registers 0 .. nregs-1
+ *   code      'ncode' bytes of bytecode
+ *
+ * The reply is the PRINT output of the program, one integer per line,
+ * followed by a single status line:
+ *
+ *   !ok            the program ran to completion
+ *   !miss          no program is cached under 'id'; resend the code
+ *   !error <msg>   the request was malformed or the program failed
+ *
+ * Each connection carries exactly one request.
+ */
+
+#define REQUEST_MAGIC      0x31494342  /* "BCI1" */
+#define REQUEST_HDR_SIZE   16          /* Bytes in the request header. */
+
+#define DEFAULT_WORKERS    4    /* Worker processes (warm VMs). */
+#define PROGRAM_CACHE_SIZE 64   /* Programs cached per worker.  */
+
+/*
+ * Listen on the Unix domain socket 'sockpath' and serve requests
+ * with 'nworkers' worker processes until SIGINT or SIGTERM.
+ * Returns 0 on a clean shutdown, nonzero if the socket can't be set up.
+ */
+int serve(char *sockpath, int nworkers);
+
+#endif  /* SERVER_H */
@@ -0,0 +1,677 @@
+/*
+ * CS 11, C track, lab 8
+ *
+ * FILE: trace.c
+ *       Trace tier: records hot loops, compiles them into specialized
+ *       traces and runs those.  See trace.h for the overview.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bci.h"
+#include "trace.h"
+
+#define BLACKLISTED 255     /* 'hot' value for loops we gave up on. */
+
+/* Kinds of values on the compiler's model of the stack. */
+#define OPND_REG    0
+#define OPND_CONST  1
+#define OPND_TEMP   2
+
+
+/* One instruction executed by the recording interpreter. */
+typedef struct
+{
+    int ip;
+    unsigned char op;
+    int arg;
+    int taken;          /* For JZ/JNZ: was the jump taken? */
+} rec_entry;
+
+/* A value on the compiler's model of the stack. */
+typedef struct
+{
+    int kind;
+    int n;              /* Register, constant or temporary number. */
+} operand;
+
+/* State while compiling a trace. */
+typedef struct
+{
+    trace *t;
+    operand stack[MAX_TRACE_DEPTH];
+    int depth;
+} compiler;
+
+
+volatile sig_atomic_t trace_running = 0;
+
+static int tracing = 1;
+static unsigned char hot[MAX_INSTS];    /* Times each header was hit. */
+static trace *traces[MAX_INSTS];        /* Trace for each header.     */
+static trace *all_traces = NULL;
+
+
+static int record(int head, rec_entry *log);
+static int *operand_ptr(compiler *c, operand o);
+static int emit(compiler *c, int op, int *dst, int *a, int *b);
+static int new_temp(compiler *c, operand *o);
+static int push_operand(compiler *c, int kind, int n);
+static int push_const(compiler *c, int val);
+static int add_exit(compiler *c, int ip);
+static int compile_binop(compiler *c, unsigned char op);
+static int compile_store(compiler *c, int r);
+static int compile_branch(compiler *c, rec_entry *e);
+static trace *compile(int head, rec_entry *log, int n);
+static void run_trace(trace *t);
+
+
+void set_tracing(int on)
+{
+    tracing = on;
+}
+
+
+void trace_reset(void)
+{
+    trace *t, *next;
+
+    for (t = all_traces; t != NULL; t = next)
+    {
+        next = t->next;
+        traces[t->head] = NULL;
+        free(t);
+    }
+
+    all_traces = NULL;
+    trace_running = 0;
+    memset(hot, 0, sizeof(hot));
+}
+
+
+/*
+ * Recording.
+ */
+
+/*
+ * Run one iteration of the loop at 'head' (where 'vm.ip' is now),
+ * logging each instruction.  The instructions are really executed, so
+ * the VM is in a consistent state whatever happens.  Returns the
+ * number of entries logged if the iteration ended by jumping back to
+ * 'head', or 0 if the loop can't be traced; in that case 'vm.ip' is
+ * left where the interpreter should continue.
+ */
+static int record(int head, rec_entry *log)
+{
+    int n, site, val;
+    unsigned char op;
+
+    for (n = 0; n < MAX_TRACE_LEN; n++)
+    {
+        site = vm.ip;
+        op = vm.inst[site];
+        vm.op_ip = site;
+
+        /* STOP and bad opcodes are left for the interpreter. */
+        if ((op == STOP) || (op > READ))
+        {
+            return 0;
+        }
+
+        vm.ip++;
+        val = 0;
+
+        switch (op)
+        {
+        case PUSH:
+            val = read_n_byte_integer(4);
+            do_push(val);
+            break;
+
+        case POP:
+            do_pop();
+            break;
+
+        case LOAD:
+            val = read_n_byte_integer(1);
+            do_load(val);
+            break;
+
+        case STORE:
+            val = read_n_byte_integer(1);
+            do_store(val);
+            break;
+
+        case JMP:
+            val = read_n_byte_integer(2);
+            do_jmp(val);
+            break;
+
+        case JZ:
+            val = read_n_byte_integer(2);
+            do_jz(val);
+            break;
+
+        case JNZ:
+            val = read_n_byte_integer(2);
+            do_jnz(val);
+            break;
+
+        case ADD:
+            do_add();
+            break;
+
+        case SUB:
+            do_sub();
+            break;
+
+        case MUL:
+            do_mul();
+            break;
+
+        case DIV:
+            do_div();
+            break;
+
+        case PRINT:
+            do_print();
+            break;
+
+        case READ:
+            do_read();
+            break;
+
+        default:    /* NOP */
+            break;
+        }
+
+        log[n].ip = site;
+        log[n].op = op;
+        log[n].arg = val;
+        log[n].taken = (vm.ip != site + instruction_size(op));
+
+        /* A backward jump either closes our loop or a different one. */
+        if (((op == JMP) || (op == JZ) || (op == JNZ)) && (vm.ip <= site))
+        {
+            return (vm.ip == head) ? n + 1 : 0;
+        }
+    }
+
+    return 0;
+}
+
+
+/*
+ * Compilation.
+ *
+ * Each compile_* function returns 0 if the trace has to be abandoned.
+ */
+
+static int *operand_ptr(compiler *c, operand o)
+{
+    switch (o.kind)
+    {
+    case OPND_REG:
+        return &vm.reg[o.n];
+
+    case OPND_CONST:
+        return &c->t->consts[o.n];
+
+    default:
+        return &c->t->temps[o.n];
+    }
+}
+
+
+static int emit(compiler *c, int op, int *dst, int *a, int *b)
+{
+    trace_op *o;
+
+    if (c->t->nops == MAX_TRACE_OPS)
+    {
+        return 0;
+    }
+
+    o = &c->t->ops[c->t->nops++];
+    o->op = op;
+    o->dst = dst;
+    o->a = a;
+    o->b = b;
+    o->exit = -1;
+    return 1;
+}
+
+
+/* Make a fresh temporary. */
+static int new_temp(compiler *c, operand *o)
+{
+    if (c->t->ntemps == MAX_TRACE_OPS)
+    {
+        return 0;
+    }
+
+    o->kind = OPND_TEMP;
+    o->n = c->t->ntemps++;
+    return 1;
+}
+
+
+static int push_operand(compiler *c, int kind, int n)
+{
+    if (c->depth == MAX_TRACE_DEPTH)
+    {
+        return 0;
+    }
+
+    c->stack[c->depth].kind = kind;
+    c->stack[c->depth].n = n;
+    c->depth++;
+
+    if (c->depth > c->t->max_depth)
+    {
+        c->t->max_depth = c->depth;
+    }
+
+    return 1;
+}
+
+
+static int push_const(compiler *c, int val)
+{
+    if (c->t->nconsts == MAX_TRACE_OPS)
+    {
+        return 0;
+    }
+
+    c->t->consts[c->t->nconsts] = val;
+    return push_operand(c, OPND_CONST, c->t->nconsts++);
+}
+
+
+/*
+ * Add an exit to 'ip' that restores the current stack.  Returns the
+ * exit number, or -1 if we've run out of room.
+ */
+static int add_exit(compiler *c, int ip)
+{
+    trace *t = c->t;
+    trace_exit *e;
+    int i;
+
+    if ((t->nexits == MAX_TRACE_LEN)
+        || (t->nsnap + c->depth > MAX_TRACE_SNAP))
+    {
+        return -1;
+    }
+
+    e = &t->exits[t->nexits];
+    e->ip = ip;
+    e->first = t->nsnap;
+    e->nstack = c->depth;
+
+    for (i = 0; i < c->depth; i++)
+    {
+        t->snap[t->nsnap++] = operand_ptr(c, c->stack[i]);
+    }
+
+    return t->nexits++;
+}
+
+
+static int compile_binop(compiler *c, unsigned char op)
+{
+    operand a, b, r;
+    int x, y;
+    static const int trace_ops[] = { T_ADD, T_SUB, T_MUL, T_DIV };
+
+    if (c->depth < 2)
+    {
+        return 0;
+    }
+
+    b = c->stack[--c->depth];
+    a = c->stack[--c->depth];
+
+    /* Fold constants, except for divisions that would fault. */
+    if ((a.kind == OPND_CONST) && (b.kind == OPND_CONST))
+    {
+        x = c->t->consts[a.n];
+        y = c->t->consts[b.n];
+
+        switch (op)
+        {
+        case ADD:
+            return push_const(c, (int) ((unsigned int) x + (unsigned int) y));
+
+        case SUB:
+            return push_const(c, (int) ((unsigned int) x - (unsigned int) y));
+
+        case MUL:
+            return push_const(c, (int) ((unsigned int) x * (unsigned int) y));
+
+        default:
+            if ((y != 0) && !((x == INT_MIN) && (y == -1)))
+            {
+                return push_const(c, x / y);
+            }
+        }
+    }
+
+    return new_temp(c, &r)
+           && emit(c, trace_ops[op - ADD], operand_ptr(c, r),
+                   operand_ptr(c, a), operand_ptr(c, b))
+           && push_operand(c, r.kind, r.n);
+}
+
+
+static int compile_store(compiler *c, int r)
+{
+    operand v, tmp;
+    trace_op *last;
+    int i, moved = 0;
+
+    if (c->depth < 1)
+    {
+        return 0;
+    }
+
+    v = c->stack[--c->depth];
+
+    /*
+     * Anything still on the stack that refers to register 'r' must be
+     * copied out before 'r' is overwritten.
+     */
+    for (i = 0; i < c->depth; i++)
+    {
+        if ((c->stack[i].kind == OPND_REG) && (c->stack[i].n == r))
+        {
+            if (!new_temp(c, &tmp)
+                || !emit(c, T_MOV, operand_ptr(c, tmp),
+                         &vm.reg[r], NULL))
+            {
+                return 0;
+            }
+
+            c->stack[i] = tmp;
+            moved = 1;
+        }
+    }
+
+    if ((v.kind == OPND_REG) && (v.n == r))
+    {
+        return 1;   /* LOAD r; STORE r */
+    }
+
+    /*
+     * If the value was computed by the last operation, have that
+     * operation write to the register directly.
+     */
+    if ((v.kind == OPND_TEMP) && !moved && (c->t->nops > 0))
+    {
+        last = &c->t->ops[c->t->nops - 1];
+
+        if (last->dst == operand_ptr(c, v))
+        {
+            last->dst = &vm.reg[r];
+            return 1;
+        }
+    }
+
+    return emit(c, T_MOV, &vm.reg[r], operand_ptr(c, v), NULL);
+}
+
+
+/* Turn a JZ/JNZ into a guard that checks it goes the recorded way. */
+static int compile_branch(compiler *c, rec_entry *e)
+{
+    operand v;
+    int exit_ip, want_zero, ex;
+
+    if (c->depth < 1)
+    {
+        return 0;
+    }
+
+    v = c->stack[--c->depth];
+
+    /* Zero on JZ taken or JNZ not taken. */
+    want_zero = ((e->op == JZ) == e->taken);
+
+    if (v.kind == OPND_CONST)
+    {
+        return 1;   /* Always goes the way it went while recording. */
+    }
+
+    /* If the guard fails we go where the recording didn't. */
+    exit_ip = e->taken ? e->ip + instruction_size(e->op) : e->arg;
+    ex = add_exit(c, exit_ip);
+
+    if ((ex < 0) || !emit(c, want_zero ? T_GUARD_Z : T_GUARD_NZ,
+                          NULL, operand_ptr(c, v), NULL))
+    {
+        return 0;
+    }
+
+    c->t->ops[c->t->nops - 1].exit = ex;
+    return 1;
+}
+
+
+/* Compile a recorded loop iteration.  Returns NULL on failure. */
+static trace *compile(int head, rec_entry *log, int n)
+{
+    compiler c;
+    rec_entry *e;
+    int i, ok = 1;
+    operand tmp;
+
+    c.t = (trace *) malloc(sizeof(trace));
+
+    if (c.t == NULL)
+    {
+        return NULL;
+    }
+
+    c.t->head = head;
+    c.t->site = log[n - 1].ip;
+    c.t->max_depth = 0;
+    c.t->nops = 0;
+    c.t->nconsts = 0;
+    c.t->ntemps = 0;
+    c.t->nexits = 0;
+    c.t->nsnap = 0;
+    c.depth = 0;
+
+    for (i = 0; ok && (i < n); i++)
+    {
+        e = &log[i];
+
+        switch (e->op)
+        {
+        case PUSH:
+            ok = push_const(&c, e->arg);
+            break;
+
+        case POP:
+            ok = (c.depth > 0);
+            c.depth--;
+            break;
+
+        case LOAD:
+            ok = push_operand(&c, OPND_REG, e->arg);
+            break;
+
+        case STORE:
+            ok = compile_store(&c, e->arg);
+            break;
+
+        case JZ:
+        case JNZ:
+            ok = compile_branch(&c, e);
+            break;
+
+        case ADD:
+        case SUB:
+        case MUL:
+        case DIV:
+            ok = compile_binop(&c, e->op);
+            break;
+
+        case PRINT:
+            ok = (c.depth > 0);
+            c.depth--;
+            ok = ok && emit(&c, T_PRINT, NULL,
+                            operand_ptr(&c, c.stack[c.depth]), NULL);
+            break;
+
+        case READ:
+            ok = new_temp(&c, &tmp)
+                 && emit(&c, T_READ, operand_ptr(&c, tmp), NULL, NULL)
+                 && push_operand(&c, tmp.kind, tmp.n);
+            break;
+
+        default:    /* NOP, and JMP which needs no code at all */
+            break;
+        }
+    }
+
+    /* Each iteration has to leave the stack as it found it. */
+    if (!ok || (c.depth != 0) || !emit(&c, T_LOOP, NULL, NULL, NULL))
+    {
+        free(c.t);
+        return NULL;
+    }
+
+    return c.t;
+}
+
+
+/*
+ * Execution.
+ */
+
+/* Run a trace until one of its guards fails. */
+static void run_trace(trace *t)
+{
+    trace_op *op = t->ops;
+    trace_exit *e;
+    int i;
+
+    while (1)
+    {
+        switch (op->op)
+        {
+        case T_MOV:
+            *op->dst = *op->a;
+            break;
+
+        case T_ADD:
+            *op->dst = *op->a + *op->b;
+            break;
+
+        case T_SUB:
+            *op->dst = *op->a - *op->b;
+            break;
+
+        case T_MUL:
+            *op->dst = *op->a * *op->b;
+            break;
+
+        case T_DIV:
+            if (*op->b == 0)
+            {
+                vm_error("division by zero");
+            }
+            if (*op->a == INT_MIN && *op->b == -1)
+            {
+                vm_error("integer overflow dividing %d by -1", INT_MIN);
+            }
+            *op->dst = *op->a / *op->b;
+            break;
+
+        case T_PRINT:
+            fprintf(vm.out, "%d\n", *op->a);
+            break;
+
+        case T_READ:
+            *op->dst = next_input();
+            break;
+
+        case T_GUARD_Z:
+        case T_GUARD_NZ:
+            if ((*op->a == 0) != (op->op == T_GUARD_Z))
+            {
+                /* Put back what the bytecode would have on the stack. */
+                e = &t->exits[op->exit];
+
+                for (i = 0; i < e->nstack; i++)
+                {
+                    vm.stack[vm.sp++] = *t->snap[e->first + i];
+                }
+
+                vm.ip = e->ip;
+                return;
+            }
+            break;
+
+        case T_LOOP:
+            backward_jump(t->site, t->head);
+            op = t->ops;
+            continue;
+        }
+
+        op++;
+    }
+}
+
+
+void trace_loop(void)
+{
+    static rec_entry recording[MAX_TRACE_LEN];
+    int head = vm.ip;
+    int n;
+    trace *t;
+
+    if (!tracing)
+    {
+        return;
+    }
+
+    t = traces[head];
+
+    if (t == NULL)
+    {
+        if ((hot[head] == BLACKLISTED) || (++hot[head] < HOT_LOOP))
+        {
+            return;
+        }
+
+        n = record(head, recording);
+        t = (n > 0) ? compile(head, recording, n) : NULL;
+
+        if (t == NULL)
+        {
+            hot[head] = BLACKLISTED;
+            return;
+        }
+
+        traces[head] = t;
+        t->next = all_traces;
+        all_traces = t;
+    }
+
+    /*
+     * Recording ran an iteration, which may have left the loop.  The
+     * trace also mustn't overflow the stack where the interpreter
+     * would have stopped with an error.
+     */
+    if ((vm.ip == head) && (vm.sp + t->max_depth <= STACK_SIZE - 1))
+    {
+        trace_running = 1;
+        vm.op_ip = head;
+        run_trace(t);
+        trace_running = 0;
+    }
+}
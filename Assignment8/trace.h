@@ -0,0 +1,109 @@
+/*
+ * CS 11, C track, lab 8
+ *
+ * FILE: trace.h
+ *       Header file for the trace tier of the bytecode interpreter.
+ *
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <signal.h>
+
+/*
+ * The trace tier.
+ *
+ * The interpreter counts how often each backward jump target (a loop
+ * header) is reached.  Once a header is hot, one iteration of the loop
+ * is run by a recording interpreter that logs every instruction, and
+ * the log is compiled into a trace: a straight-line list of operations
+ * on registers, constants and temporaries, with the stack traffic of
+ * the bytecode removed and each conditional jump replaced by a guard.
+ * The trace then runs in a loop until a guard fails, at which point
+ * any values the bytecode would have left on the stack are pushed
+ * back and the interpreter resumes at the guard's exit.
+ *
+ * Loops that can't be traced (nested loops, STOP inside the loop,
+ * bodies that don't leave the stack as they found it, ...) are
+ * blacklisted and stay in the interpreter.
+ */
+
+#define HOT_LOOP          50    /* Iterations before a loop is traced. */
+#define MAX_TRACE_LEN     128   /* Bytecode instructions in a trace.   */
+#define MAX_TRACE_OPS     256   /* Operations in a compiled trace.     */
+#define MAX_TRACE_DEPTH   32    /* Stack depth a trace may reach.      */
+#define MAX_TRACE_SNAP    512   /* Stack values saved over all exits.  */
+
+/* Trace operations. */
+#define T_MOV       0   /* dst = a                            */
+#define T_ADD       1   /* dst = a + b                        */
+#define T_SUB       2   /* dst = a - b                        */
+#define T_MUL       3   /* dst = a * b                        */
+#define T_DIV       4   /* dst = a / b                        */
+#define T_PRINT     5   /* print a                            */
+#define T_READ      6   /* dst = next input value             */
+#define T_GUARD_Z   7   /* leave through 'exit' unless a == 0 */
+#define T_GUARD_NZ  8   /* leave through 'exit' unless a != 0 */
+#define T_LOOP      9   /* back to the start of the trace     */
+
+/*
+ * Operands point straight at a VM register, a constant or a
+ * temporary of the trace.
+ */
+
+typedef struct
+{
+    int op;
+    int *dst;
+    int *a;
+    int *b;
+    int exit;           /* Index into 'exits', for guards. */
+} trace_op;
+
+typedef struct
+{
+    int ip;             /* Where the interpreter resumes.         */
+    int first;          /* First stack value to restore in 'snap'. */
+    int nstack;         /* Number of stack values to restore.     */
+} trace_exit;
+
+typedef struct _trace
+{
+    int head;           /* The loop header.                          */
+    int site;           /* The backward jump that closes the loop.   */
+    int max_depth;      /* Deepest the stack gets within the loop.   */
+    int nops;
+    int nconsts;
+    int ntemps;
+    int nexits;
+    int nsnap;
+    trace_op ops[MAX_TRACE_OPS];
+    int consts[MAX_TRACE_OPS];
+    int temps[MAX_TRACE_OPS];
+    trace_exit exits[MAX_TRACE_LEN];
+    int *snap[MAX_TRACE_SNAP];
+    struct _trace *next;    /* Next in the list of all traces. */
+} trace;
+
+/*
+ * Nonzero while a trace is running.  'vm.ip' then stays at the loop
+ * header; the profiler uses this to tell the two apart.
+ */
+extern volatile sig_atomic_t trace_running;
+
+/* Turn the trace tier on (the default) or off. */
+void set_tracing(int on);
+
+/* Drop all traces and counters, e.g. when a new program is loaded. */
+void trace_reset(void);
+
+/*
+ * Called by the interpreter right after a backward jump has been
+ * taken, with 'vm.ip' at the loop header.  Counts the header and, if
+ * the loop is hot, records, compiles and runs its trace.  On return
+ * 'vm.ip' and the stack are wherever the interpreter should carry on.
+ */
+void trace_loop(void);
+
+#endif  /* TRACE_H */